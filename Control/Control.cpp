@@ -0,0 +1,144 @@
+/**
+ * @file Control.cpp
+ * @brief Control library implementation
+ *
+ * Copyright (C) 2013 Marco Pensallorto
+ * < marco DOT pensallorto AT gmail DOT com >
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+**/
+#include <Control.h>
+
+/* -- static functions ------------------------------------------------------ */
+
+/* bounds PID terms, wide enough not to matter once summed */
+static const long TERM_MAX = 4L * CONTROL_DUTY_MAX << CONTROL_GAIN_SHIFT;
+
+static long clamp(long x, long lo, long hi)
+{
+    return (x < lo) ? lo : (hi < x) ? hi : x;
+}
+
+/** -- public functions ----------------------------------------------------- */
+void control_hysteresis_init(control_hysteresis_t *hyst, temp_t offset)
+{
+    hyst->offset = offset;
+    hyst->on = 0;
+}
+
+int control_hysteresis(void *state, temp_t curr, temp_t goal)
+{
+    control_hysteresis_t *hyst = (control_hysteresis_t *) state;
+
+    if (! hyst->on) {
+        if (curr < temp_sub(goal, hyst->offset))
+            hyst->on = 1;
+    }
+    else {
+        if (temp_add(goal, hyst->offset) < curr)
+            hyst->on = 0;
+    }
+
+    return hyst->on ? CONTROL_DUTY_MAX : 0;
+}
+
+void control_pid_init(control_pid_t *pid, int kp, int ki, int kd)
+{
+    pid->kp = kp;
+    pid->ki = ki;
+    pid->kd = kd;
+
+    pid->integral = 0;
+    pid->last = 0;
+    pid->primed = 0;
+}
+
+int control_pid(void *state, temp_t curr, temp_t goal)
+{
+    control_pid_t *pid = (control_pid_t *) state;
+    const long full = (long) CONTROL_DUTY_MAX << CONTROL_GAIN_SHIFT;
+    long error = (long) goal - curr;
+    long p, i, d, out;
+
+    /* no derivative on the first update */
+    if (! pid->primed) {
+        pid->last = curr;
+        pid->primed = 1;
+    }
+
+    p = clamp(pid->kp * error, - TERM_MAX, TERM_MAX);
+    d = clamp(- pid->kd * ((long) curr - pid->last), - TERM_MAX, TERM_MAX);
+    i = clamp(pid->integral + pid->ki * error, 0, full);
+    pid->last = curr;
+
+    out = p + i + d;
+
+    /* anti-windup: keep the integral term where it is while the duty is
+       saturated and the error would push it further */
+    if ((full < out && 0 < error) || (out < 0 && error < 0))
+        i = pid->integral;
+
+    pid->integral = i;
+
+    out = clamp(p + i + d, 0, full);
+    return (int) (out >> CONTROL_GAIN_SHIFT);
+}
+
+void control_relay_init(control_relay_t *relay, uint8_t pin,
+                        unsigned long window, unsigned long min_on,
+                        unsigned long min_off)
+{
+    relay->pin = pin;
+    relay->window = window;
+    relay->min_on = min_on;
+    relay->min_off = min_off;
+
+    relay->window_start = relay->last_switch = 0;
+    relay->on = relay->switched = 0;
+
+    pinMode(pin, OUTPUT);
+    digitalWrite(pin, LOW);
+}
+
+void control_relay_update(control_relay_t *relay, unsigned long now,
+                          int duty)
+{
+    unsigned long elapsed = now - relay->window_start;
+    unsigned char on;
+
+    if (relay->window <= elapsed) {
+        relay->window_start = now;
+        elapsed = 0;
+    }
+
+    on = (elapsed * CONTROL_DUTY_MAX <
+          relay->window * (unsigned long) clamp(duty, 0, CONTROL_DUTY_MAX));
+
+    if (on == relay->on)
+        return;
+
+    /* protect the relay, hold the current state long enough */
+    if (relay->switched &&
+        now - relay->last_switch < (relay->on ? relay->min_on
+                                                : relay->min_off))
+        return;
+
+    relay->on = on;
+    relay->switched = 1;
+    relay->last_switch = now;
+
+    digitalWrite(relay->pin, on ? HIGH : LOW);
+}
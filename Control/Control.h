@@ -0,0 +1,157 @@
+/**
+ * @file Control.h
+ * @brief Control laws and time-proportioned relay output
+ *
+ * Copyright (C) 2013 Marco Pensallorto
+ * < marco DOT pensallorto AT gmail DOT com >
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+**/
+#ifndef CONTROL_H_DEFINED
+#define CONTROL_H_DEFINED
+
+#include <Arduino.h>
+
+/* A control law turns the current temperature and the setpoint into a
+   heater duty, from 0 (off) to CONTROL_DUTY_MAX (always on). Laws are
+   pluggable: a control_law_t pairs the update function of a law with
+   its state. Two are provided, a hysteresis (bang-bang) law and a fixed
+   point PID. Either way, the duty drives a relay by time proportioning
+   (see control_relay_update), within minimum on and off times.
+
+   Laws are meant to be updated at a fixed period, the PID gains are
+   per period. */
+
+const int CONTROL_DUTY_MAX = 1000;
+
+/* PID gains are fixed-point, with this many fractional bits */
+const int CONTROL_GAIN_SHIFT = 8;
+
+/* -- custom typedefs ------------------------------------------------------- */
+
+/* temperatures, in hundredths of a Celsius degree (see Thermistor.h).
+   Arithmetic on them saturates (see temp_add and temp_sub) */
+typedef int16_t temp_t;
+const temp_t TEMP_MAX = 32767;
+const temp_t TEMP_MIN = -32767 - 1;
+
+/* returns the duty for temperature curr and setpoint goal */
+typedef int control_law_fn_t(void *state, temp_t curr, temp_t goal);
+
+typedef struct {
+
+    /** law update function */
+    control_law_fn_t *update;
+
+    /** law state, e.g. a control_pid_t */
+    void *state;
+} control_law_t;
+
+typedef struct {
+
+    /** switches on below goal - offset, off above goal + offset */
+    temp_t offset;
+
+    /** true while on */
+    unsigned char on;
+} control_hysteresis_t;
+
+typedef struct {
+
+    /** gains, in duty per centi-degree of error (kp), of error summed
+        over periods (ki), of temperature change per period (kd). Fixed
+        point, see CONTROL_GAIN_SHIFT */
+    int kp;
+    int ki;
+    int kd;
+
+    /** integral term, fixed point */
+    long integral;
+
+    /** temperature at the previous update */
+    temp_t last;
+    unsigned char primed;
+} control_pid_t;
+
+typedef struct {
+
+    /** output pin */
+    uint8_t pin;
+
+    /** time proportioning window, and minimum on and off times (ms) */
+    unsigned long window;
+    unsigned long min_on;
+    unsigned long min_off;
+
+    /** start of the current window, time of the last switch */
+    unsigned long window_start;
+    unsigned long last_switch;
+
+    /** true while on, true once switched */
+    unsigned char on;
+    unsigned char switched;
+} control_relay_t;
+
+/* -- public interface ------------------------------------------------------ */
+
+/** returns a + b, saturated to the temp_t range */
+inline temp_t temp_add(temp_t a, temp_t b)
+{
+    long res = (long) a + b;
+    return (TEMP_MAX < res) ? TEMP_MAX : (res < TEMP_MIN) ? TEMP_MIN : res;
+}
+
+/** returns a - b, saturated to the temp_t range */
+inline temp_t temp_sub(temp_t a, temp_t b)
+{
+    long res = (long) a - b;
+    return (TEMP_MAX < res) ? TEMP_MAX : (res < TEMP_MIN) ? TEMP_MIN : res;
+}
+
+/** returns the duty of law for temperature curr and setpoint goal */
+inline int control_update(control_law_t *law, temp_t curr, temp_t goal)
+{
+    return law->update(law->state, curr, goal);
+}
+
+/** initializes a hysteresis law state, off */
+void control_hysteresis_init(control_hysteresis_t *hyst, temp_t offset);
+
+/** hysteresis law, state is a control_hysteresis_t. Returns either 0 or
+    CONTROL_DUTY_MAX */
+int control_hysteresis(void *state, temp_t curr, temp_t goal);
+
+/** initializes a PID law state, with gains (see control_pid_t) */
+void control_pid_init(control_pid_t *pid, int kp, int ki, int kd);
+
+/** PID law, state is a control_pid_t. The derivative term acts on the
+    temperature rather than on the error, setpoint changes do not kick
+    it. The integral term is clamped to the duty range and stops growing
+    while the duty is saturated (anti-windup) */
+int control_pid(void *state, temp_t curr, temp_t goal);
+
+/** initializes a relay on pin, off. Times are in ms */
+void control_relay_init(control_relay_t *relay, uint8_t pin,
+                        unsigned long window, unsigned long min_on,
+                        unsigned long min_off);
+
+/** drives a relay at time now (ms), to be invoked periodically. It stays
+    on for duty / CONTROL_DUTY_MAX of each window, but it is never
+    switched before min_on (resp. min_off) since the last switch */
+void control_relay_update(control_relay_t *relay, unsigned long now,
+                          int duty);
+
+#endif
@@ -30,50 +30,100 @@ const int DEBOUNCE_DEFAULT_RESOLUTION = 10;
 const int DEBOUNCE_DEFAULT_CLICK_TICKS = 10;
 const int DEBOUNCE_DEFAULT_HOLD_TICKS  = 100;
 
+/* max number of distinct I/O ports a bank samples from (AVR only). Inputs
+   of a bank are sampled a whole port at a time: pins sharing a port cost
+   a single register read per tick. */
+const int DEBOUNCE_MAX_PORTS = 3;
+
+/* Uncomment the following line to debounce with bit-parallel vertical
+   counters instead (see VerticalDebouncerBank.h). It suits panels with
+   many buttons, but then MAX_DEBOUNCERS is ignored: the bank holds one
+   debouncer per bit of a machine word, 8 on AVR. */
+/* #define DEBOUNCE_USE_VERTICAL */
+
+/* Banks poll their buttons from a permanent timer by default. Uncomment
+   the following line to have them poll only after a pin change
+   interrupt, until all buttons are back idle, so that the MCU may sleep
+   in between (see debouncers_check). AVR only, and the host harness
+   which emulates them: the library then owns the PCINT vectors, which
+   rules out SoftwareSerial. */
+/* #define DEBOUNCE_USE_PCINT */
+
 /* -- custom typedefs ------------------------------------------------------- */
+
+/* Debouncer ids carry the slot index in their lowest DEBOUNCE_ID_SLOT_BITS
+   bits and the 7 bits generation count of that slot above them. Ids of
+   disabled debouncers are rejected, until the generation of that slot
+   wraps around. */
 typedef short deb_id_t;
+const int DEBOUNCE_ID_SLOT_BITS = 8;
 
 typedef enum {
     DEB_IDLE,
     DEB_WAIT,
     DEB_CLICK,
     DEB_HOLD,
+    DEB_RELEASE,
+    DEB_DOUBLE_CLICK,
 } debouncer_state_t;
 
-typedef int debounce_handler_t(deb_id_t id, debouncer_state_t state, void *ctx);
+/* Per debouncer timing, in samples (see DebounceButton.h) */
+typedef struct {
+
+    /** high samples for a press */
+    unsigned short click;
 
-typedef struct debouncer_TAG {
+    /** consecutive high samples for the first HOLD, counted from the
+        first one: click samples included */
+    unsigned short hold;
 
-    /** id */
-    deb_id_t id;
+    /** initial and minimum HOLD repeat periods. The period shrinks by a
+        quarter at each repeat: repeat_min == repeat repeats at a fixed
+        rate. Both at least 1, repeat_min no more than repeat */
+    unsigned short repeat;
+    unsigned short repeat_min;
 
-    /** input pin to be debounced */
-    short input;
+    /** max low samples between the release of a CLICK and the next
+        press for a DOUBLE_CLICK, 0 disables DOUBLE_CLICK. Otherwise
+        CLICK is held back until then */
+    unsigned short double_click;
+} debounce_timing_t;
 
-    /** fsm */
-    debouncer_state_t state;
+typedef int debounce_handler_t(deb_id_t id, debouncer_state_t state, void *ctx);
 
-    /** callback */
-    debounce_handler_t *handler;
+/* -- helpers --------------------------------------------------------------- */
 
-    /** reserved the user callback */
-    void *user_data;
+/* returns the id of slot index at generation gen */
+inline deb_id_t debounce_id(unsigned char gen, unsigned char index)
+{
+    return (deb_id_t) ((gen & 0x7F) << DEBOUNCE_ID_SLOT_BITS) | index;
+}
 
-    /** current number of high samples */
-    ticks_t ticks_high;
+/* returns the generation encoded in id */
+inline unsigned char debounce_id_gen(deb_id_t id)
+{
+    return (unsigned char) (id >> DEBOUNCE_ID_SLOT_BITS);
+}
 
-    /** number of high samples required for click */
-    ticks_t ticks_click;
+/* returns the slot index encoded in id, -1 if out of range */
+inline int debounce_id_index(deb_id_t id, int max_slots)
+{
+    int index = id & ((1 << DEBOUNCE_ID_SLOT_BITS) - 1);
 
-    /** number of high samples required for hold */
-    ticks_t ticks_hold;
+    return (0 <= id && index < max_slots) ? index : -1;
+}
 
-    struct debouncer_TAG *next;
-} debouncer_t ;
+/* returns the generation following gen */
+inline unsigned char debounce_id_next_gen(unsigned char gen)
+{
+    return (gen + 1) & 0x7F;
+}
 
 /* -- public interface ------------------------------------------------------ */
 
-/** initialize debounce library (call from setup) */
+/** initialize debounce library (call from setup). click_ticks and
+    hold_ticks are the default timing of debouncers (see
+    debouncers_enable) */
 int debouncers_init(ticks_t resolution  = DEBOUNCE_DEFAULT_RESOLUTION,
                     ticks_t click_ticks = DEBOUNCE_DEFAULT_CLICK_TICKS,
                     ticks_t hold_ticks  = DEBOUNCE_DEFAULT_HOLD_TICKS);
@@ -81,11 +131,30 @@ int debouncers_init(ticks_t resolution  = DEBOUNCE_DEFAULT_RESOLUTION,
 /** returns true if lib is initialized, false otherwise. */
 int debouncers_is_initialized();
 
-/** arms a debouncer with user-provided data */
+/** arms a debouncer with user-provided data. The handler gets CLICK on
+    press, HOLD while held and RELEASE on release. With a DOUBLE_CLICK
+    window, CLICK comes once the window closes after the release, and a
+    second press within it gets DOUBLE_CLICK instead (see
+    DebounceButton.h). timing defaults to a fixed HOLD repeat every
+    hold_ticks and no DOUBLE_CLICK (see debouncers_init) */
 deb_id_t debouncers_enable(debounce_handler_t handler,
-                           short input, void *user_data);
+                           short input, void *user_data,
+                           const debounce_timing_t *timing = NULL);
+
+/** arms polling after a pin change, to be invoked by main loop(). Does
+    nothing unless DEBOUNCE_USE_PCINT is defined */
+void debouncers_check();
 
-/** stops a debouncer with given id */
+/** stops a debouncer with given id, and frees its slot for reuse.
+    Returns 0 if succesful, -1 if not found */
 int debouncers_disable(deb_id_t id);
 
+/** stops sampling a debouncer with given id, keeping its slot. Returns 0
+    if succesful, -1 if not found */
+int debouncers_pause(deb_id_t id);
+
+/** resumes sampling a paused debouncer with given id, from the idle
+    state. Returns 0 if succesful, -1 if not found */
+int debouncers_resume(deb_id_t id);
+
 #endif
@@ -0,0 +1,192 @@
+/**
+ * @file DebounceButton.h
+ * @brief Button event state machine shared by the debouncer banks
+ *
+ * Copyright (C) 2013 Marco Pensallorto
+ * < marco DOT pensallorto AT gmail DOT com >
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+**/
+#ifndef DEBOUNCE_BUTTON_H_DEFINED
+#define DEBOUNCE_BUTTON_H_DEFINED
+
+#include <Debounce.h>
+#include <Debug.h>
+
+/* Once a bank has debounced an input, the events of the button are
+   decided here, on sample counts only: no timers are involved. Each
+   function returns the event triggered by a sample, DEB_IDLE if none.
+
+   A press emits CLICK. With a double click window, the CLICK is held
+   back instead: a press within double_click low samples of its release
+   emits DOUBLE_CLICK in its place, otherwise CLICK is emitted once the
+   window closes, the button being up already. HOLD comes on the hold-th
+   consecutive high sample, counting from the first one (the click ones
+   included), and repeats every repeat samples; the period shrinks by a
+   quarter (one sample at least) at each repeat, down to repeat_min.
+   A press held until HOLD is no click. Letting the button go emits
+   RELEASE, except after a held back CLICK. */
+
+/* double click window closed */
+const unsigned short DEBOUNCE_NO_WINDOW = 0xFFFF;
+
+/* -- custom typedefs ------------------------------------------------------- */
+typedef struct {
+
+    /** timing, see debouncers_enable */
+    debounce_timing_t timing;
+
+    /** last event, or DEB_IDLE / DEB_WAIT */
+    debouncer_state_t state;
+
+    /** high samples since the press, then since the last HOLD */
+    unsigned short ticks_high;
+
+    /** low samples since a CLICK was released, DEBOUNCE_NO_WINDOW if
+        none is pending */
+    unsigned short ticks_low;
+
+    /** current HOLD repeat period */
+    unsigned short period;
+
+    /** true while a CLICK is held back (see double_click) */
+    unsigned char pending;
+} debounce_button_t;
+
+/* -- helpers --------------------------------------------------------------- */
+
+/* resets button, with given timing */
+inline void debounce_button_init(debounce_button_t *button,
+                                 const debounce_timing_t *timing)
+{
+    button->timing = *timing;
+
+    /* a period of 0 samples would HOLD on every sample */
+    ASSERT(0 < timing->repeat_min && timing->repeat_min <= timing->repeat);
+
+    button->state = DEB_IDLE;
+    button->ticks_high = 0;
+    button->ticks_low = DEBOUNCE_NO_WINDOW;
+    button->period = timing->repeat;
+    button->pending = 0;
+}
+
+/* returns true while the double click window of button is open */
+inline int debounce_button_window(const debounce_button_t *button)
+{
+    return (0 < button->timing.double_click &&
+            button->ticks_low <= button->timing.double_click);
+}
+
+/* button was just debounced as pressed, ticks_high samples ago */
+inline debouncer_state_t debounce_button_press(debounce_button_t *button)
+{
+    int dbl = debounce_button_window(button);
+
+    button->ticks_low = DEBOUNCE_NO_WINDOW;
+    if (dbl) {
+        /* takes the place of the CLICK held back */
+        button->pending = 0;
+        button->state = DEB_DOUBLE_CLICK;
+        return DEB_DOUBLE_CLICK;
+    }
+
+    button->state = DEB_CLICK;
+    if (0 < button->timing.double_click) {
+        button->pending = 1;
+        return DEB_IDLE;
+    }
+
+    return DEB_CLICK;
+}
+
+/* a low sample */
+inline debouncer_state_t debounce_button_low(debounce_button_t *button)
+{
+    switch (button->state) {
+
+    case DEB_CLICK:
+    case DEB_DOUBLE_CLICK:
+    case DEB_HOLD:
+        /* only a short single click opens the double click window */
+        button->ticks_low = (DEB_CLICK == button->state)
+            ? 0 : DEBOUNCE_NO_WINDOW;
+
+        button->ticks_high = 0;
+        button->state = DEB_RELEASE;
+
+        /* a held back CLICK comes later, with no RELEASE */
+        return button->pending ? DEB_IDLE : DEB_RELEASE;
+
+    default:
+        if (button->ticks_low < DEBOUNCE_NO_WINDOW)
+            ++ button->ticks_low;
+
+        button->ticks_high = 0;
+        button->state = DEB_IDLE;
+
+        /* no second press within the window, it was a single click */
+        if (button->pending && ! debounce_button_window(button)) {
+            button->pending = 0;
+            button->ticks_low = DEBOUNCE_NO_WINDOW;
+            return DEB_CLICK;
+        }
+
+        return DEB_IDLE;
+    }
+}
+
+/* a high sample while pressed */
+inline debouncer_state_t debounce_button_high(debounce_button_t *button)
+{
+    const debounce_timing_t *timing = &button->timing;
+
+    ++ button->ticks_high;
+
+    switch(button->state) {
+
+    case DEB_CLICK:
+    case DEB_DOUBLE_CLICK:
+        if (button->ticks_high >= timing->hold) {
+            button->state = DEB_HOLD;
+            button->ticks_high = 0;
+            button->period = timing->repeat;
+            button->pending = 0;
+            return DEB_HOLD;
+        }
+        break;
+
+    case DEB_HOLD:
+        if (button->ticks_high >= button->period) {
+            button->ticks_high = 0;
+
+            /* accelerate, by one sample at least */
+            button->period -= (button->period + 3) / 4;
+            if (button->period < timing->repeat_min)
+                button->period = timing->repeat_min;
+
+            return DEB_HOLD;
+        }
+        break;
+
+    default:
+        HALT(); /* unexpected */
+    }
+
+    return DEB_IDLE;
+}
+
+#endif
@@ -0,0 +1,167 @@
+/**
+ * @file DebouncePorts.h
+ * @brief Batched input sampling for the debouncer banks
+ *
+ * Copyright (C) 2013 Marco Pensallorto
+ * < marco DOT pensallorto AT gmail DOT com >
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+**/
+#ifndef DEBOUNCE_PORTS_H_DEFINED
+#define DEBOUNCE_PORTS_H_DEFINED
+
+#include <Debounce.h>
+#include <Arduino.h>
+
+/* Debouncer banks sample their inputs through a DebouncePorts. On AVR,
+   pins are resolved to their input register and bit mask when added,
+   and sample() reads every register in use once: pins sharing a port
+   cost a single read per tick. So does the host build, which emulates
+   the ports of an Uno (see SIM_AVR_PORTS). Elsewhere inputs are read
+   with digitalRead().
+
+   With DEBOUNCE_USE_PCINT, added pins also have their pin change
+   interrupt enabled. The ISRs (see Debounce.cpp) count the changes, and
+   each bank compares against the count it saw last. */
+#if defined(__AVR__) || defined(SIM_AVR_PORTS)
+#define DEBOUNCE_USE_PORTS
+#endif
+
+#if defined(DEBOUNCE_USE_PCINT) && !defined(DEBOUNCE_USE_PORTS)
+#undef DEBOUNCE_USE_PCINT
+#endif
+
+#ifdef DEBOUNCE_USE_PCINT
+/* (reserved) bumped on every pin change, by the ISRs */
+extern volatile uint8_t debounce_pcint_count;
+#endif
+
+/* -- custom typedefs ------------------------------------------------------- */
+typedef struct {
+
+    /** input pin */
+    short pin;
+
+#ifdef DEBOUNCE_USE_PORTS
+    /** index of the input register in the ports in use, and pin mask */
+    unsigned char port;
+    unsigned char mask;
+#endif
+} debounce_input_t;
+
+class DebouncePorts {
+public:
+
+    /** forgets all the ports in use */
+    void init()
+    {
+        _count = 0;
+#ifdef DEBOUNCE_USE_PCINT
+        _pcint_seen = debounce_pcint_count;
+#endif
+    }
+
+    /** resolves pin into input. Returns 0 if succesful, -1 if not a
+        pin or out of ports (see DEBOUNCE_MAX_PORTS) */
+    int add(short pin, debounce_input_t *input)
+    {
+        input->pin = pin;
+
+#ifdef DEBOUNCE_USE_PORTS
+        uint8_t port = digitalPinToPort(pin);
+        int i;
+
+        if (NOT_A_PIN == port)
+            return -1;
+
+        volatile uint8_t *reg = portInputRegister(port);
+        for (i = 0; i < _count && reg != _regs[i]; ++ i)
+            ;
+
+        if (i == _count) {
+            if (DEBOUNCE_MAX_PORTS <= _count)
+                return -1;
+
+            _regs[_count ++] = reg;
+        }
+
+        input->port = i;
+        input->mask = digitalPinToBitMask(pin);
+#endif
+
+#ifdef DEBOUNCE_USE_PCINT
+        /* not every pin has a pin change interrupt */
+        volatile uint8_t *pcicr = digitalPinToPCICR(pin);
+        if (NULL == pcicr)
+            return -1;
+
+        *digitalPinToPCMSK(pin) |= bit(digitalPinToPCMSKbit(pin));
+        *pcicr |= bit(digitalPinToPCICRbit(pin));
+#endif
+        return 0;
+    }
+
+    /** returns true if any pin changed since the last call */
+    int changed()
+    {
+#ifdef DEBOUNCE_USE_PCINT
+        uint8_t count = debounce_pcint_count;
+        if (count == _pcint_seen)
+            return 0;
+
+        _pcint_seen = count;
+        return 1;
+#else
+        return 0;
+#endif
+    }
+
+    /** samples all the ports in use, once per tick */
+    void sample()
+    {
+#ifdef DEBOUNCE_USE_PORTS
+        int i;
+
+        for (i = 0; i < _count; ++ i)
+            _samples[i] = *_regs[i];
+#endif
+    }
+
+    /** returns true if input was high in the last sample */
+    int read(const debounce_input_t *input)
+    {
+#ifdef DEBOUNCE_USE_PORTS
+        return 0 != (_samples[input->port] & input->mask);
+#else
+        return HIGH == digitalRead(input->pin);
+#endif
+    }
+
+private:
+#ifdef DEBOUNCE_USE_PORTS
+    /* input registers of the ports in use, and their last sample */
+    volatile uint8_t *_regs[DEBOUNCE_MAX_PORTS];
+    uint8_t _samples[DEBOUNCE_MAX_PORTS];
+#endif
+    unsigned char _count;
+
+#ifdef DEBOUNCE_USE_PCINT
+    /* pin change count seen last */
+    uint8_t _pcint_seen;
+#endif
+};
+
+#endif
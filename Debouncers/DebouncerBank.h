@@ -0,0 +1,381 @@
+/**
+ * @file DebouncerBank.h
+ * @brief Compile-time sized button debouncer banks
+ *
+ * Copyright (C) 2013 Marco Pensallorto
+ * < marco DOT pensallorto AT gmail DOT com >
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+**/
+#ifndef DEBOUNCER_BANK_H_DEFINED
+#define DEBOUNCER_BANK_H_DEFINED
+
+#include <Timers.h>
+#include <Debounce.h>
+#include <DebouncePorts.h>
+#include <DebounceButton.h>
+#include <Debug.h>
+#include <Arduino.h>
+
+#include <string.h>
+
+/* A bank of up to N debouncers, with storage sized at compile time. The
+   debouncers_* functions drive a default instance of it; sketches can
+   declare their own, e.g.
+
+       static DebouncerBank<3> panel;
+
+   and call init() and enable() on it. Each bank polls its inputs from a
+   periodic timer on the default Timers instance, a whole port at a time
+   (see DebouncePorts.h).
+
+   Debouncer ids are generation-tagged slot indexes (see Debounce.h):
+   disable, pause and resume look their slot up in O(1), and active
+   debouncers are kept in a doubly linked list for O(1) removal. */
+template <int N>
+class DebouncerBank {
+public:
+
+    /** returns true if bank is initialized, false otherwise */
+    int is_initialized()
+    { return _initialized; }
+
+    /** initialize the bank (call from setup) */
+    int init(ticks_t resolution, ticks_t click_ticks, ticks_t hold_ticks)
+    {
+        int i = N - 1;
+
+        ASSERT(N <= (1 << DEBOUNCE_ID_SLOT_BITS));
+
+        _free_list = NULL;
+        _active_list = NULL;
+        _cursor = NULL;
+        _ports.init();
+
+        while (0 <= i) {
+            memset(_array + i, 0, sizeof(debouncer_t));
+            _array[i].next = _free_list;
+            _free_list = &_array[i];
+
+            -- i;
+        }
+
+        /* setup static data */
+        _resolution = resolution;
+        ASSERT(0 < _resolution);
+
+        /* default timing, HOLD repeats at a fixed rate */
+        _timing.click = click_ticks;
+        ASSERT(0 < click_ticks);
+
+        _timing.hold = _timing.repeat = _timing.repeat_min = hold_ticks;
+        ASSERT(0 < hold_ticks);
+
+        _timing.double_click = 0;
+
+        /* with DEBOUNCE_USE_PCINT polling starts on the first pin change
+           (see wakeup), and stops once all buttons are idle again */
+        _polling = _rearm = 0;
+#ifndef DEBOUNCE_USE_PCINT
+        start_polling();
+#endif
+
+        _initialized = 1;
+
+        return 0;
+    }
+
+    /** arms a debouncer with user-provided data, and timing (NULL for
+        the default, see init). Returns its id, -1 on failure */
+    deb_id_t enable(debounce_handler_t *handler, short input, void *user_data,
+                    const debounce_timing_t *timing = NULL)
+    {
+        debounce_input_t resolved;
+        ASSERT (is_initialized());
+
+        /* resolve pin to its port once and for all */
+        if (NULL == _free_list || 0 != _ports.add(input, &resolved))
+            return -1;
+
+        /* fetch head from free list, the slot moves one generation on */
+        debouncer_t *elem = _free_list;
+        _free_list = _free_list->next;
+
+        elem->gen = debounce_id_next_gen(elem->gen);
+
+        /* populate data structure */
+        elem->input = resolved;
+        elem->handler = handler;
+        elem->user_data = user_data;
+
+        debounce_button_init(&elem->button,
+                             (NULL != timing) ? timing : &_timing);
+
+        link(elem);
+        return debounce_id(elem->gen, elem - _array);
+    }
+
+    /** stops a debouncer and frees its slot. Returns 0 if succesful, -1
+        if not found */
+    int disable(deb_id_t id)
+    {
+        ASSERT (is_initialized());
+
+        debouncer_t *debouncer = lookup(id);
+        if (NULL == debouncer)
+            return -1;
+
+        if (DEB_SLOT_ACTIVE == debouncer->status)
+            unlink(debouncer);
+
+        /* put block back into free list */
+        debouncer->status = DEB_SLOT_FREE;
+        debouncer->next = _free_list;
+        _free_list = debouncer;
+
+        return 0;
+    }
+
+    /** stops sampling a debouncer, keeping its slot. No RELEASE is
+        reported for a button held at that time. Returns 0 if succesful,
+        -1 if not found */
+    int pause(deb_id_t id)
+    {
+        ASSERT (is_initialized());
+
+        debouncer_t *debouncer = lookup(id);
+        if (NULL == debouncer)
+            return -1;
+
+        if (DEB_SLOT_ACTIVE == debouncer->status) {
+            unlink(debouncer);
+            debouncer->status = DEB_SLOT_PAUSED;
+        }
+
+        return 0;
+    }
+
+    /** resumes sampling a paused debouncer, from the idle state. Returns 0
+        if succesful, -1 if not found */
+    int resume(deb_id_t id)
+    {
+        ASSERT (is_initialized());
+
+        debouncer_t *debouncer = lookup(id);
+        if (NULL == debouncer)
+            return -1;
+
+        if (DEB_SLOT_PAUSED == debouncer->status) {
+            debounce_button_init(&debouncer->button,
+                                 &debouncer->button.timing);
+            link(debouncer);
+        }
+
+        return 0;
+    }
+
+    /** arms polling after a pin change, to be invoked by main loop() */
+    void wakeup()
+    {
+        if (_ports.changed() && ! _polling)
+            start_polling();
+    }
+
+private:
+    typedef enum {
+        DEB_SLOT_FREE,
+        DEB_SLOT_ACTIVE,
+        DEB_SLOT_PAUSED,
+    } slot_status_t;
+
+    typedef struct debouncer_TAG {
+
+        /** input pin to be debounced */
+        debounce_input_t input;
+
+        /** callback */
+        debounce_handler_t *handler;
+
+        /** reserved the user callback */
+        void *user_data;
+
+        /** fsm */
+        debounce_button_t button;
+
+        /** generation count, bumped on every allocation (see ids) */
+        unsigned char gen;
+
+        /** slot_status_t */
+        unsigned char status;
+
+        /** active (or free) list links */
+        struct debouncer_TAG *next;
+        struct debouncer_TAG **pprev;
+    } debouncer_t;
+
+    /* configurable parameters (see init) */
+    ticks_t _resolution;
+    debounce_timing_t _timing;
+
+    debouncer_t _array[N];
+    debouncer_t *_free_list;
+    debouncer_t *_active_list;
+
+    /* next debouncer to be sampled by check(), handlers may remove it */
+    debouncer_t *_cursor;
+
+    DebouncePorts _ports;
+
+    /* true while the polling timer is active, and set when polling is
+       asked for again meanwhile, e.g. by a handler (see check) */
+    int _polling;
+    int _rearm;
+
+    int _initialized;
+
+    /* returns the allocated debouncer with given id, NULL if not found */
+    debouncer_t *lookup(deb_id_t id)
+    {
+        int index = debounce_id_index(id, N);
+        if (index < 0)
+            return NULL;
+
+        debouncer_t *debouncer = &_array[index];
+        return (DEB_SLOT_FREE != debouncer->status &&
+                debounce_id_gen(id) == debouncer->gen)
+            ? debouncer : NULL;
+    }
+
+    /* head insertion in the active list */
+    void link(debouncer_t *debouncer)
+    {
+        debouncer->status = DEB_SLOT_ACTIVE;
+
+        debouncer->pprev = &_active_list;
+        debouncer->next = _active_list;
+        if (NULL != _active_list)
+            _active_list->pprev = &debouncer->next;
+
+        _active_list = debouncer;
+
+        /* the button may be pressed already, no need to wait for a pin
+           change to find out */
+        start_polling();
+    }
+
+    void unlink(debouncer_t *debouncer)
+    {
+        if (_cursor == debouncer)
+            _cursor = debouncer->next;
+
+        *debouncer->pprev = debouncer->next;
+        if (NULL != debouncer->next)
+            debouncer->next->pprev = debouncer->pprev;
+
+        debouncer->next = NULL;
+        debouncer->pprev = NULL;
+    }
+
+    /* schedules the polling timer, unless already active */
+    void start_polling()
+    {
+        if (_polling) {
+            _rearm = 1;
+            return;
+        }
+
+        _polling = (0 <= timers_schedule(_resolution, check, this));
+    }
+
+    /* (reserved) this is used as a callback with Timers library */
+    static int check(timer_id_t unused, ticks_t now, void *data)
+    {
+        DebouncerBank *bank = (DebouncerBank *) data;
+        debouncer_t *head = bank->_active_list;
+        int idle = 1;
+        ASSERT (bank->is_initialized());
+
+        bank->_rearm = 0;
+
+        /* one read per port, shared by all the pins on it */
+        bank->_ports.sample();
+
+        while (NULL != head) {
+            const int button = bank->_ports.read(&head->input);
+            const debouncer_state_t event = fsm(head, button);
+
+            /* a pending double click window needs counting too */
+            idle &= (DEB_IDLE == head->button.state &&
+                     ! debounce_button_window(&head->button));
+
+            /* the handler may disable or pause any debouncer */
+            bank->_cursor = head->next;
+            if (DEB_IDLE != event) {
+                debounce_handler_t *handler = head->handler;
+
+                /** @TODO do something with return code? */
+                handler(debounce_id(head->gen, head - bank->_array),
+                        event, head->user_data);
+            }
+
+            head = bank->_cursor;
+        } /* while */
+
+        bank->_cursor = NULL;
+
+#ifdef DEBOUNCE_USE_PCINT
+        /* all buttons released and no handler enabled or resumed one,
+           wait for the next pin change */
+        if (idle && ! bank->_rearm) {
+            bank->_polling = 0;
+            return 0;
+        }
+#endif
+
+        return 1; /* infinite rescheduling */
+    }
+
+    /* returns the event triggered, DEB_IDLE if none */
+    static debouncer_state_t fsm (debouncer_t *debouncer, int input)
+    {
+        debounce_button_t *button = &debouncer->button;
+
+        if (! input)
+            return debounce_button_low(button);
+
+        /* FSM transition relation */
+        switch(button->state) {
+
+        case DEB_IDLE:
+        case DEB_RELEASE:
+            button->state = DEB_WAIT;
+            button->ticks_high = 1;
+            break;
+
+        case DEB_WAIT:
+            if (++ button->ticks_high >= button->timing.click)
+                return debounce_button_press(button);
+            break;
+
+        default:
+            return debounce_button_high(button);
+        }
+
+        return DEB_IDLE;
+    }
+};
+
+#endif
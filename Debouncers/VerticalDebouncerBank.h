@@ -0,0 +1,427 @@
+/**
+ * @file VerticalDebouncerBank.h
+ * @brief Bit-parallel (vertical counter) button debouncer banks
+ *
+ * Copyright (C) 2013 Marco Pensallorto
+ * < marco DOT pensallorto AT gmail DOT com >
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+**/
+#ifndef VERTICAL_DEBOUNCER_BANK_H_DEFINED
+#define VERTICAL_DEBOUNCER_BANK_H_DEFINED
+
+#include <Timers.h>
+#include <Debounce.h>
+#include <DebouncePorts.h>
+#include <DebounceButton.h>
+#include <Debug.h>
+#include <Arduino.h>
+
+#include <string.h>
+
+/* A bank of debouncers for panels with many buttons, one per bit of a
+   machine word W (8 inputs on AVR, 32 elsewhere by default). It offers
+   the same interface and events as DebouncerBank (see DebouncerBank.h).
+
+   Each tick counts the consecutive high samples of all the inputs at
+   once, in vertical counters: bit i of plane j holds bit j of the count
+   of input i. Counts are reset by a low sample and stop at the click
+   threshold of each input, kept in planes alike, which makes it
+   pressed. Incrementing and comparing take a handful of bitwise
+   operations per plane, log2(click) planes in all. The per button state
+   machine (see DebounceButton.h) only runs for inputs that are pressed,
+   were just released or have a double click window open.
+
+   Debouncer ids are generation-tagged bit numbers (see Debounce.h).
+   Disabling, pausing and resuming a debouncer only flip its bits. */
+#ifdef __AVR__
+typedef uint8_t debounce_word_t;
+#else
+typedef uint32_t debounce_word_t;
+#endif
+
+template <typename W = debounce_word_t>
+class VerticalDebouncerBank {
+public:
+
+    /** returns true if bank is initialized, false otherwise */
+    int is_initialized()
+    { return _initialized; }
+
+    /** initialize the bank (call from setup). Click thresholds may not
+        exceed 255 */
+    int init(ticks_t resolution, ticks_t click_ticks, ticks_t hold_ticks)
+    {
+        memset(_array, 0, sizeof(_array));
+        memset(_planes, 0, sizeof(_planes));
+        memset(_clicks, 0, sizeof(_clicks));
+        _used = _active = _pressed = _windows = 0;
+        _depth = 0;
+        _ports.init();
+
+        /* setup static data */
+        _resolution = resolution;
+        ASSERT(0 < _resolution);
+
+        /* default timing, HOLD repeats at a fixed rate */
+        _timing.click = click_ticks;
+        ASSERT(0 < click_ticks);
+
+        _timing.hold = _timing.repeat = _timing.repeat_min = hold_ticks;
+        ASSERT(0 < hold_ticks);
+
+        _timing.double_click = 0;
+
+        /* with DEBOUNCE_USE_PCINT polling starts on the first pin change
+           (see wakeup), and stops once all buttons are idle again */
+        _polling = _rearm = 0;
+#ifndef DEBOUNCE_USE_PCINT
+        start_polling();
+#endif
+
+        _initialized = 1;
+
+        return 0;
+    }
+
+    /** arms a debouncer with user-provided data, and timing (NULL for
+        the default, see init) */
+    deb_id_t enable(debounce_handler_t *handler, short input, void *user_data,
+                    const debounce_timing_t *timing = NULL)
+    {
+        int i, j;
+        ASSERT (is_initialized());
+
+        if (NULL == timing)
+            timing = &_timing;
+
+        /* like DebouncerBank, the first high sample only arms the
+           button: it takes at least two to click */
+        unsigned click = (timing->click < 2) ? 2 : timing->click;
+        ASSERT(click < (1 << MAX_PLANES));
+
+        /* first free bit */
+        for (i = 0; i < WIDTH && (_used & word_bit(i)); ++ i)
+            ;
+
+        if (WIDTH == i)
+            return -1;
+
+        debouncer_t *debouncer = &_array[i];
+
+        /* resolve pin to its port once and for all */
+        if (0 != _ports.add(input, &debouncer->input))
+            return -1;
+
+        /* populate data structure, the slot moves one generation on */
+        debouncer->gen = debounce_id_next_gen(debouncer->gen);
+
+        debouncer->handler = handler;
+        debouncer->user_data = user_data;
+
+        debounce_button_init(&debouncer->button, timing);
+        debouncer->button.timing.click = click;
+
+        /* store the threshold in the planes, enough of them to count up
+           to it */
+        for (j = 0; j < MAX_PLANES; ++ j) {
+            if ((click >> j) & 1)
+                _clicks[j] |= word_bit(i);
+        }
+
+        while ((1U << _depth) <= click)
+            ++ _depth;
+
+        _used |= word_bit(i);
+        _active |= word_bit(i);
+
+        /* the button may be pressed already, no need to wait for a pin
+           change to find out */
+        start_polling();
+        return debounce_id(debouncer->gen, i);
+    }
+
+    /** stops a debouncer and frees its slot. Returns 0 if succesful, -1
+        if not found */
+    int disable(deb_id_t id)
+    {
+        int i = lookup(id), j;
+        if (i < 0)
+            return -1;
+
+        forget(i);
+        _used &= ~word_bit(i);
+
+        for (j = 0; j < MAX_PLANES; ++ j)
+            _clicks[j] &= ~word_bit(i);
+
+        return 0;
+    }
+
+    /** stops sampling a debouncer, keeping its slot. No RELEASE is
+        reported for a button held at that time. Returns 0 if succesful,
+        -1 if not found */
+    int pause(deb_id_t id)
+    {
+        int i = lookup(id);
+        if (i < 0)
+            return -1;
+
+        forget(i);
+        return 0;
+    }
+
+    /** resumes sampling a paused debouncer, from the idle state. Returns 0
+        if succesful, -1 if not found */
+    int resume(deb_id_t id)
+    {
+        int i = lookup(id);
+        if (i < 0)
+            return -1;
+
+        if (! (_active & word_bit(i))) {
+            debounce_button_t *button = &_array[i].button;
+            debounce_button_init(button, &button->timing);
+
+            _active |= word_bit(i);
+            start_polling();
+        }
+
+        return 0;
+    }
+
+    /** arms polling after a pin change, to be invoked by main loop() */
+    void wakeup()
+    {
+        if (_ports.changed() && ! _polling)
+            start_polling();
+    }
+
+private:
+    enum {
+        WIDTH      = 8 * sizeof(W),
+        MAX_PLANES = 8,
+    };
+
+    typedef struct {
+
+        /** input pin to be debounced */
+        debounce_input_t input;
+
+        /** callback */
+        debounce_handler_t *handler;
+
+        /** reserved the user callback */
+        void *user_data;
+
+        /** fsm */
+        debounce_button_t button;
+
+        /** generation count, bumped on every allocation (see ids) */
+        unsigned char gen;
+    } debouncer_t;
+
+    /* configurable parameters (see init) */
+    ticks_t _resolution;
+    debounce_timing_t _timing;
+
+    debouncer_t _array[WIDTH];
+    DebouncePorts _ports;
+
+    /* vertical counters and click thresholds, _depth planes in use */
+    W _planes[MAX_PLANES];
+    W _clicks[MAX_PLANES];
+    unsigned char _depth;
+
+    /* allocated inputs, sampled (i.e. not paused) inputs, inputs
+       debounced as pressed and inputs with a double click window open */
+    W _used;
+    W _active;
+    W _pressed;
+    W _windows;
+
+    /* true while the polling timer is active, and set when polling is
+       asked for again meanwhile, e.g. by a handler (see check) */
+    int _polling;
+    int _rearm;
+
+    int _initialized;
+
+    /* returns the bit number of the debouncer with given id, -1 if not
+       found */
+    int lookup(deb_id_t id)
+    {
+        ASSERT (is_initialized());
+
+        int i = debounce_id_index(id, WIDTH);
+        return (0 <= i && (_used & word_bit(i)) &&
+                debounce_id_gen(id) == _array[i].gen) ? i : -1;
+    }
+
+    /* stops sampling input i, dropping its counters */
+    void forget(int i)
+    {
+        W mask = ~word_bit(i);
+        int j;
+
+        _active &= mask;
+        _pressed &= mask;
+        _windows &= mask;
+
+        for (j = 0; j < MAX_PLANES; ++ j)
+            _planes[j] &= mask;
+    }
+
+    /* schedules the polling timer, unless already active */
+    void start_polling()
+    {
+        if (_polling) {
+            _rearm = 1;
+            return;
+        }
+
+        _polling = (0 <= timers_schedule(_resolution, check, this));
+    }
+
+    static inline W word_bit(int i)
+    { return (W) 1 << i; }
+
+    /* returns the number of the lowest bit set in word, which is not 0 */
+    static inline int word_index(W word)
+    {
+        return (sizeof(W) <= sizeof(unsigned)) ? __builtin_ctz(word)
+            : (sizeof(W) <= sizeof(unsigned long)) ? __builtin_ctzl(word)
+            : __builtin_ctzll(word);
+    }
+
+    /* gathers the inputs of the last sample in a word, reading the
+       active ones only */
+    W sample()
+    {
+        W word = 0, todo = _active;
+        int i;
+
+        _ports.sample();
+        for (; 0 != todo; todo &= todo - 1) {
+            i = word_index(todo);
+            if (_ports.read(&_array[i].input))
+                word |= word_bit(i);
+        }
+
+        return word;
+    }
+
+    /* counts consecutive high samples, returns the pressed inputs */
+    W count(W input)
+    {
+        W carry = input & ~_pressed; /* pressed inputs stop counting */
+        W equal = ~(W) 0;
+        int j;
+
+        for (j = 0; j < _depth; ++ j) {
+            W plane = _planes[j];
+
+            /* ripple increment, cleared where the input is low */
+            _planes[j] = (plane ^ carry) & input;
+            carry &= plane;
+
+            /* match against bit j of the thresholds */
+            equal &= ~(_planes[j] ^ _clicks[j]);
+        }
+
+        return equal & _active;
+    }
+
+    /* (reserved) this is used as a callback with Timers library */
+    static int check(timer_id_t unused, ticks_t now, void *data)
+    {
+        VerticalDebouncerBank *bank = (VerticalDebouncerBank *) data;
+        int i;
+        ASSERT (bank->is_initialized());
+
+        bank->_rearm = 0;
+
+        W input = bank->sample();
+        W pressed = bank->count(input);
+        W changed = pressed ^ bank->_pressed;
+        W todo = pressed | changed | bank->_windows;
+
+        bank->_pressed = pressed;
+        for (; 0 != todo; todo &= todo - 1) {
+            i = word_index(todo);
+
+            W mask = word_bit(i);
+            debouncer_t *debouncer = &bank->_array[i];
+
+            /* a handler may have disabled or paused it in the meantime */
+            if (! (bank->_active & mask))
+                continue;
+
+            debounce_button_t *button = &debouncer->button;
+
+            debouncer_state_t event = fsm(button, input & mask,
+                                          pressed & mask, changed & mask);
+            if (DEB_IDLE != event) {
+                debounce_handler_t *handler = debouncer->handler;
+
+                /** @TODO do something with return code? */
+                handler(debounce_id(debouncer->gen, i), event,
+                        debouncer->user_data);
+
+                if (! (bank->_active & mask))
+                    continue;
+            }
+
+            if (debounce_button_window(button))
+                bank->_windows |= mask;
+            else
+                bank->_windows &= ~mask;
+        } /* for */
+
+#ifdef DEBOUNCE_USE_PCINT
+        /* all buttons released and no handler enabled or resumed one,
+           wait for the next pin change */
+        if (0 == input && 0 == bank->_windows && ! bank->_rearm) {
+            bank->_polling = 0;
+            return 0;
+        }
+#endif
+
+        return 1; /* infinite rescheduling */
+    }
+
+    /* returns the event triggered, DEB_IDLE if none */
+    static debouncer_state_t fsm(debounce_button_t *button, W input,
+                                 W pressed, W changed)
+    {
+        if (! input)
+            return debounce_button_low(button);
+
+        /* still counting, a press in the making */
+        if (! pressed)
+            return DEB_IDLE;
+
+        /* just debounced, the counter saw click high samples */
+        if (changed) {
+            button->ticks_high = button->timing.click;
+            return debounce_button_press(button);
+        }
+
+        return debounce_button_high(button);
+    }
+};
+
+#endif
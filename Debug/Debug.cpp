@@ -8,6 +8,8 @@ int debug_init()
     /* reserved for DEBUG */
     pinMode(do_error, OUTPUT);
     FLASH();
+
+    return 0;
 }
 
 int debug_error()
@@ -0,0 +1,145 @@
+/**
+ * @file EventRing.h
+ * @brief Lock-free single producer, single consumer event ring
+ *
+ * Copyright (C) 2013 Marco Pensallorto
+ * < marco DOT pensallorto AT gmail DOT com >
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+**/
+#ifndef EVENT_RING_H_DEFINED
+#define EVENT_RING_H_DEFINED
+
+#include <TimerCore.h>
+#include <Arduino.h>
+
+/* A ring of N deferred calls (N a power of two, up to 128). One side
+   posts, the other dispatches, and neither needs to disable interrupts:
+   each index is a single byte written by its own side only, so either
+   side may run in an ISR. All posts to a ring must come from the same
+   context, though, e.g. loop() or a given ISR. */
+
+/* keeps the compiler from moving memory accesses across */
+#define EVENT_BARRIER() __asm__ __volatile__ ("" ::: "memory")
+
+/* -- custom typedefs ------------------------------------------------------- */
+typedef void event_handler_t(long arg, int code, void *ctx);
+
+typedef struct {
+
+    /** deferred call */
+    event_handler_t *handler;
+
+    /** handler arguments */
+    long arg;
+    int code;
+    void *ctx;
+} event_t;
+
+template <int N>
+class EventRing {
+public:
+
+    /** empties the ring and clears the overflow count, to be invoked with
+        no producer running */
+    void init()
+    {
+        TIMER_CORE_STATIC_ASSERT(0 < N && N <= 128 && 0 == (N & (N - 1)),
+                                 event_ring_bad_size);
+
+        _head = _tail = 0;
+        _overflows = 0;
+    }
+
+    /** posts an event, producer side. Returns 0 if succesful, -1 if the
+        ring is full (and counts the overflow) */
+    int post(event_handler_t *handler, long arg, int code, void *ctx)
+    {
+        uint8_t head = _head;
+
+        if (N == (uint8_t) (head - _tail)) {
+            ++ _overflows;
+            return -1;
+        }
+
+        event_t *event = &_ring[head & (N - 1)];
+        event->handler = handler;
+        event->arg = arg;
+        event->code = code;
+        event->ctx = ctx;
+
+        /* the event must be complete before it is published */
+        EVENT_BARRIER();
+        _head = head + 1;
+
+        return 0;
+    }
+
+    /** returns true if events are waiting, consumer side */
+    int pending()
+    { return _head != _tail; }
+
+    /** runs the oldest event, consumer side. Returns 0 if succesful, -1 if
+        the ring is empty */
+    int dispatch()
+    {
+        uint8_t tail = _tail;
+
+        if (_head == tail)
+            return -1;
+
+        /* copy it out, the slot is free for reuse once tail moves on */
+        EVENT_BARRIER();
+        event_t event = _ring[tail & (N - 1)];
+
+        EVENT_BARRIER();
+        _tail = tail + 1;
+
+        event.handler(event.arg, event.code, event.ctx);
+        return 0;
+    }
+
+    /** returns the number of events rejected because the ring was full */
+    unsigned overflows()
+    {
+        unsigned res;
+
+#ifdef __AVR__
+        /* the count is wider than a byte, read it in one go */
+        uint8_t sreg = SREG;
+        cli();
+        res = _overflows;
+        SREG = sreg;
+#else
+        res = _overflows;
+#endif
+
+        return res;
+    }
+
+private:
+    event_t _ring[N];
+
+    /* free running indexes, _head is written by the producer and _tail
+       by the consumer only */
+    volatile uint8_t _head;
+    volatile uint8_t _tail;
+
+    /* written by the producer only */
+    volatile unsigned _overflows;
+};
+
+#endif
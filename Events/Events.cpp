@@ -0,0 +1,94 @@
+/**
+ * @file Events.cpp
+ * @brief Events library implementation
+ *
+ * Copyright (C) 2013 Marco Pensallorto
+ * < marco DOT pensallorto AT gmail DOT com >
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+**/
+#include <Events.h>
+#include <EventRing.h>
+#include <Debug.h>
+
+/* -- static data ----------------------------------------------------------- */
+static EventRing<MAX_EVENTS> _rings[EVENT_PRIORITIES];
+static int _initialized;
+
+/** -- public functions ----------------------------------------------------- */
+int events_is_initialized()
+{ return _initialized; }
+
+int events_init()
+{
+    int prio;
+
+    for (prio = 0; prio < EVENT_PRIORITIES; ++ prio)
+        _rings[prio].init();
+
+    _initialized = 1;
+    return 0;
+}
+
+int events_post(event_prio_t prio, event_handler_t handler,
+                long arg, int code, void *ctx)
+{
+    ASSERT(0 <= prio && prio < EVENT_PRIORITIES);
+
+    /* loop() has work to do, don't let it sleep */
+    timers_wake();
+    return _rings[prio].post(handler, arg, code, ctx);
+}
+
+int events_dispatch()
+{
+    int count = 0, prio = 0;
+    ASSERT(events_is_initialized());
+
+    while (prio < EVENT_PRIORITIES &&
+           count < MAX_EVENTS * EVENT_PRIORITIES) {
+
+        /* after each event, start over from the highest priority */
+        if (0 == _rings[prio].dispatch()) {
+            ++ count;
+            prio = 0;
+        }
+        else ++ prio;
+    } /* while */
+
+    return count;
+}
+
+unsigned events_overflows(event_prio_t prio)
+{
+    ASSERT(0 <= prio && prio < EVENT_PRIORITIES);
+    return _rings[prio].overflows();
+}
+
+int events_timer_post(timer_id_t id, ticks_t now, void *source)
+{
+    event_source_t *src = (event_source_t *) source;
+
+    events_post(src->prio, src->handler, id, 0, src->ctx);
+    return src->periodic;
+}
+
+int events_debounce_post(deb_id_t id, debouncer_state_t state, void *source)
+{
+    event_source_t *src = (event_source_t *) source;
+
+    return events_post(src->prio, src->handler, id, state, src->ctx);
+}
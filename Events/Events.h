@@ -0,0 +1,97 @@
+/**
+ * @file Events.h
+ * @brief Events library header file
+ *
+ * Copyright (C) 2013 Marco Pensallorto
+ * < marco DOT pensallorto AT gmail DOT com >
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+**/
+#ifndef EVENTS_H_DEFINED
+#define EVENTS_H_DEFINED
+
+#include <Timers.h>
+#include <Debounce.h>
+#include <EventRing.h>
+
+/* Timers and debouncers run their handlers from within timers_check(),
+   one slow handler delays all the others. Handlers can be deferred
+   instead: their timer or debouncer only posts an event, and loop()
+   runs the events later on, by priority (see events_dispatch).
+
+   Deferred handlers are described by an event source, passed as the
+   user data of events_timer_post (to timers_schedule) or of
+   events_debounce_post (to debouncers_enable). */
+
+const int MAX_EVENTS = 4; /* per priority, a power of two */
+
+/* -- custom typedefs ------------------------------------------------------- */
+typedef enum {
+    EVENT_PRIO_HIGH,
+    EVENT_PRIO_NORMAL,
+    EVENT_PRIO_LOW,
+
+    EVENT_PRIORITIES,
+} event_prio_t;
+
+typedef struct {
+
+    /** deferred handler, gets the timer or debouncer id as arg, and the
+        debouncer state (or 0) as code */
+    event_handler_t *handler;
+
+    /** reserved for the user */
+    void *ctx;
+
+    event_prio_t prio;
+
+    /** timers only: true to keep the timer rescheduled */
+    int periodic;
+} event_source_t;
+
+/* -- public interface ------------------------------------------------------ */
+
+/** returns true if lib is initialized, false otherwise */
+int events_is_initialized();
+
+/** initializes the library. Must be invoked once, before using the
+    library */
+int events_init();
+
+/** posts an event. Returns 0 if succesful, -1 if the queue for prio is
+    full. Posts to a priority must all come from the same context (see
+    EventRing.h), which may be an ISR. Also gets timers_idle() to
+    return */
+int events_post(event_prio_t prio, event_handler_t handler,
+                long arg, int code, void *ctx);
+
+/** runs pending events, higher priorities first, to be invoked by main
+    loop(). Stops after MAX_EVENTS * EVENT_PRIORITIES events, so that
+    handlers posting events cannot keep loop() busy. Returns the number
+    of events run */
+int events_dispatch();
+
+/** returns the number of events rejected because the queue for prio was
+    full */
+unsigned events_overflows(event_prio_t prio);
+
+/** timer handler posting an event for source. Returns source->periodic */
+int events_timer_post(timer_id_t id, ticks_t now, void *source);
+
+/** debouncer handler posting an event for source */
+int events_debounce_post(deb_id_t id, debouncer_state_t state, void *source);
+
+#endif
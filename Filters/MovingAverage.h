@@ -0,0 +1,82 @@
+/**
+ * @file MovingAverage.h
+ * @brief Moving average filter with an incremental running sum
+ *
+ * Copyright (C) 2013 Marco Pensallorto
+ * < marco DOT pensallorto AT gmail DOT com >
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+**/
+#ifndef MOVING_AVERAGE_H_DEFINED
+#define MOVING_AVERAGE_H_DEFINED
+
+/* The average of the last N samples (N up to 255) of integer type T,
+   e.g. raw ADC counts. Samples are kept in a ring along with their
+   running sum: adding one costs an add and a subtract, whatever N. The
+   sum type S must hold N samples, e.g. 64 10-bit ADC counts fit an
+   unsigned int. Being exact integer arithmetic, the sum never drifts. */
+template <int N, typename T = unsigned int, typename S = unsigned long>
+class MovingAverage {
+public:
+
+    /** empties the filter */
+    void init()
+    {
+        _sum = 0;
+        _count = _last = 0;
+    }
+
+    /** adds a sample, replacing the oldest one once full */
+    void add(T sample)
+    {
+        if (N == _count)
+            _sum -= _samples[_last];
+        else
+            ++ _count;
+
+        _samples[_last] = sample;
+        _sum += sample;
+
+        if (N == ++ _last)
+            _last = 0;
+    }
+
+    /** returns true once N samples were added */
+    int is_full()
+    { return N == _count; }
+
+    /** returns the number of samples averaged, up to N */
+    int count()
+    { return _count; }
+
+    /** returns the sum of the samples, for averages finer than a unit */
+    S sum()
+    { return _sum; }
+
+    /** returns the average of the samples, rounded down. 0 if empty */
+    T average()
+    { return _count ? (T) (_sum / _count) : 0; }
+
+private:
+    T _samples[N];
+    S _sum;
+
+    /* samples added, up to N, and next slot to write */
+    unsigned char _count;
+    unsigned char _last;
+};
+
+#endif
@@ -0,0 +1,200 @@
+/**
+ * @file Arduino.h
+ * @brief Mock Arduino core, for native host builds (see Sim.h)
+ *
+ * Copyright (C) 2013 Marco Pensallorto
+ * < marco DOT pensallorto AT gmail DOT com >
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+**/
+#ifndef ARDUINO_H_DEFINED
+#define ARDUINO_H_DEFINED
+
+/* Just enough of the Arduino core for the libraries and sketches of this
+   repository to build and run natively. Time is virtual and pins are
+   scripted, see Sim.h. Not being __AVR__, the libraries take their
+   portable paths (no sleep, no interrupts off), except where the input
+   ports of an Uno are emulated, see below. */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <math.h>
+
+/* core version, also defined on the command line as the real toolchain does */
+#ifndef ARDUINO
+#define ARDUINO 105
+#endif
+
+#define HIGH 0x1
+#define LOW  0x0
+
+#define INPUT        0x0
+#define OUTPUT       0x1
+#define INPUT_PULLUP 0x2
+
+#define DEC 10
+#define HEX 16
+#define OCT 8
+#define BIN 2
+
+#define PROGMEM
+#define pgm_read_byte(addr) (*(const uint8_t *) (addr))
+#define pgm_read_word(addr) (*(const uint16_t *) (addr))
+
+#define F(s) (s)
+
+#define bit(b) (1UL << (b))
+
+#define interrupts()
+#define noInterrupts()
+
+typedef uint8_t byte;
+typedef bool boolean;
+
+/* -- time ------------------------------------------------------------------ */
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+
+/* -- pins ------------------------------------------------------------------ */
+void pinMode(uint8_t pin, uint8_t mode);
+int digitalRead(uint8_t pin);
+void digitalWrite(uint8_t pin, uint8_t value);
+int analogRead(uint8_t pin);
+
+/* -- ports ----------------------------------------------------------------- */
+
+/* The input registers and pin change interrupts of an Uno, as in its
+   pins_arduino.h: pins 0 to 7 on port D, 8 to 13 on port B and A0 to A5
+   on port C. The input registers follow the pin levels, and a change on
+   a pin enabled in PCMSKx and PCICR runs the ISR of its port (see
+   avr/interrupt.h). Libraries reading ports test SIM_AVR_PORTS. */
+#define SIM_AVR_PORTS
+
+#define NOT_A_PIN 0
+#define PB 2
+#define PC 3
+#define PD 4
+
+extern volatile uint8_t PINB, PINC, PIND;
+extern volatile uint8_t PCICR, PCMSK0, PCMSK1, PCMSK2;
+
+extern const uint8_t sim_pin_to_port[];
+extern const uint8_t sim_pin_to_bit_mask[];
+extern volatile uint8_t * const sim_port_to_input[];
+
+#define digitalPinToPort(P)     (sim_pin_to_port[P])
+#define digitalPinToBitMask(P)  (sim_pin_to_bit_mask[P])
+#define portInputRegister(P)    (sim_port_to_input[P])
+
+#define digitalPinToPCICR(p)    (((p) >= 0 && (p) <= 19) ? (&PCICR) : \
+                                 ((volatile uint8_t *) 0))
+#define digitalPinToPCICRbit(p) (((p) <= 7) ? 2 : (((p) <= 13) ? 0 : 1))
+#define digitalPinToPCMSK(p)    (((p) <= 7) ? (&PCMSK2) : \
+                                 (((p) <= 13) ? (&PCMSK0) : (&PCMSK1)))
+#define digitalPinToPCMSKbit(p) (((p) <= 7) ? (p) : \
+                                 (((p) <= 13) ? ((p) - 8) : ((p) - 14)))
+
+/* -- printing -------------------------------------------------------------- */
+class Print {
+public:
+    virtual ~Print() {}
+    virtual size_t write(uint8_t c) = 0;
+
+    size_t write(const char *s)
+    {
+        size_t n = 0;
+        while (*s)
+            n += write((uint8_t) *s++);
+        return n;
+    }
+
+    size_t write(const uint8_t *buf, size_t size)
+    {
+        size_t n = 0;
+        while (size --)
+            n += write(*buf++);
+        return n;
+    }
+
+    size_t print(const char *s)
+    { return write(s); }
+
+    size_t print(char c)
+    { return write((uint8_t) c); }
+
+    size_t print(long n, int base = DEC)
+    {
+        if (n < 0 && DEC == base)
+            return print('-') + print((unsigned long) - n, base);
+        return print((unsigned long) n, base);
+    }
+
+    size_t print(unsigned long n, int base = DEC)
+    {
+        char buf[8 * sizeof(long) + 1];
+        char *p = buf + sizeof(buf);
+
+        if (base < 2)
+            base = DEC;
+
+        *--p = '\0';
+        do {
+            *--p = "0123456789ABCDEF"[n % base];
+            n /= base;
+        } while (n);
+
+        return write(p);
+    }
+
+    size_t print(int n, int base = DEC)
+    { return print((long) n, base); }
+
+    size_t print(unsigned int n, int base = DEC)
+    { return print((unsigned long) n, base); }
+
+    size_t println()
+    { return write('\n'); }
+
+    template <typename T>
+    size_t println(T x)
+    { return print(x) + println(); }
+
+    template <typename T>
+    size_t println(T x, int base)
+    { return print(x, base) + println(); }
+};
+
+class HardwareSerial : public Print {
+public:
+    void begin(unsigned long baud) {}
+    void end() {}
+    int available() { return 0; }
+    int read() { return -1; }
+    void flush() { fflush(stdout); }
+
+    size_t write(uint8_t c)
+    { return (EOF != fputc(c, stdout)) ? 1 : 0; }
+
+    using Print::write;
+};
+
+extern HardwareSerial Serial;
+
+#endif
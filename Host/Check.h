@@ -0,0 +1,61 @@
+/**
+ * @file Check.h
+ * @brief Minimal checks and timing for the host tests
+ *
+ * Copyright (C) 2013 Marco Pensallorto
+ * < marco DOT pensallorto AT gmail DOT com >
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+**/
+#ifndef CHECK_H_DEFINED
+#define CHECK_H_DEFINED
+
+#include <stdio.h>
+#include <time.h>
+
+/* Each host test (see tests/) is a program of its own, run by make
+   test. CHECK reports a failed condition and goes on, the test exits
+   with check_status(), non zero if any check failed. Benchmark figures
+   are printed as they come, host CPU times are taken with check_ns().
+   Include once per program. */
+
+static int check_failures;
+
+#define CHECK(cond)                                                     \
+    do {                                                                \
+        if (! (cond)) {                                                 \
+            ++ check_failures;                                          \
+            fprintf(stderr, "%s:%d: check failed: %s\n",                \
+                    __FILE__, __LINE__, #cond);                         \
+        }                                                               \
+    } while (0)
+
+/** returns the exit status of the test */
+static inline int check_status()
+{
+    return check_failures ? 1 : 0;
+}
+
+/** returns a monotonic host time, in nanoseconds */
+static inline double check_ns()
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+#endif
@@ -0,0 +1,414 @@
+/**
+ * @file Sim.cpp
+ * @brief Mock Arduino core and simulation harness implementation
+ *
+ * Copyright (C) 2013 Marco Pensallorto
+ * < marco DOT pensallorto AT gmail DOT com >
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+**/
+#include <Sim.h>
+#include <SoftwareSerial.h>
+#include <avr/interrupt.h>
+
+HardwareSerial Serial;
+
+/* -- ports ----------------------------------------------------------------- */
+volatile uint8_t PINB, PINC, PIND;
+volatile uint8_t PCICR, PCMSK0, PCMSK1, PCMSK2;
+
+const uint8_t sim_pin_to_port[SIM_PINS] = {
+    PD, PD, PD, PD, PD, PD, PD, PD,
+    PB, PB, PB, PB, PB, PB,
+    PC, PC, PC, PC, PC, PC,
+};
+
+const uint8_t sim_pin_to_bit_mask[SIM_PINS] = {
+    1 << 0, 1 << 1, 1 << 2, 1 << 3, 1 << 4, 1 << 5, 1 << 6, 1 << 7,
+    1 << 0, 1 << 1, 1 << 2, 1 << 3, 1 << 4, 1 << 5,
+    1 << 0, 1 << 1, 1 << 2, 1 << 3, 1 << 4, 1 << 5,
+};
+
+volatile uint8_t * const sim_port_to_input[] = {
+    NULL, NULL, &PINB, &PINC, &PIND,
+};
+
+/* -- static data ----------------------------------------------------------- */
+static sim_time_t _now;
+
+typedef struct {
+    sim_time_t at;
+    uint8_t pin;
+    uint8_t value;
+} sim_event_t;
+
+/* scripted changes, sorted by time */
+static sim_event_t _events[SIM_MAX_EVENTS];
+static int _nevents;
+
+static uint8_t _inputs[SIM_PINS];
+
+/* pin change ISRs, by PCICR bit */
+static sim_isr_t *_pcint_isrs[3];
+static uint8_t _outputs[SIM_PINS];
+static unsigned long _changes[SIM_PINS];
+
+static int _analog[SIM_PINS - SIM_ANALOG_PIN0];
+static sim_analog_fn_t *_analog_fn[SIM_PINS - SIM_ANALOG_PIN0];
+static void *_analog_ctx[SIM_PINS - SIM_ANALOG_PIN0];
+
+typedef struct {
+    uint8_t pin;
+    sim_serial_peer_t *peer;
+    void *ctx;
+    unsigned long sent;
+} sim_peer_t;
+
+static SoftwareSerial *_serials[SIM_MAX_SERIALS];
+static sim_peer_t _peers[SIM_MAX_SERIALS];
+static int _npeers;
+
+/* -- static functions ------------------------------------------------------ */
+static int valid_pin(uint8_t pin)
+{
+    if (pin < SIM_PINS)
+        return 1;
+
+    fprintf(stderr, "sim: bad pin %d\n", pin);
+    abort();
+}
+
+/* sets the level of an input pin, and its bit in the input register.
+   A change runs the pin change ISR of the port, if enabled */
+static void set_input(uint8_t pin, uint8_t value)
+{
+    volatile uint8_t *reg = portInputRegister(digitalPinToPort(pin));
+    uint8_t mask = digitalPinToBitMask(pin);
+    uint8_t pcie = digitalPinToPCICRbit(pin);
+
+    value = value ? HIGH : LOW;
+    if (value == _inputs[pin])
+        return;
+
+    _inputs[pin] = value;
+    if (value)
+        *reg |= mask;
+    else
+        *reg &= ~mask;
+
+    if ((PCICR & bit(pcie)) &&
+        (*digitalPinToPCMSK(pin) & bit(digitalPinToPCMSKbit(pin))) &&
+        NULL != _pcint_isrs[pcie])
+        _pcint_isrs[pcie]();
+}
+
+/* applies the scripted changes due by now */
+static void apply_events()
+{
+    int i = 0, j;
+
+    while (i < _nevents && _events[i].at <= _now) {
+        set_input(_events[i].pin, _events[i].value);
+        ++ i;
+    }
+
+    for (j = 0; i < _nevents; ++ i, ++ j)
+        _events[j] = _events[i];
+
+    _nevents = j;
+}
+
+static sim_peer_t *lookup_peer(uint8_t tx_pin)
+{
+    int i;
+
+    for (i = 0; i < _npeers; ++ i) {
+        if (_peers[i].pin == tx_pin)
+            return &_peers[i];
+    }
+
+    return NULL;
+}
+
+/** -- public functions ----------------------------------------------------- */
+sim_time_t sim_now()
+{ return _now; }
+
+void sim_advance(sim_time_t us)
+{
+    _now += us;
+    apply_events();
+}
+
+void sim_idle(sim_time_t us)
+{
+    sim_time_t until = _now + us;
+
+    if (0 < _nevents && _events[0].at < until)
+        until = _events[0].at;
+
+    if (_now < until)
+        sim_advance(until - _now);
+}
+
+void sim_digital(uint8_t pin, int value)
+{
+    if (valid_pin(pin))
+        set_input(pin, value);
+}
+
+int sim_digital_at(sim_time_t at, uint8_t pin, int value)
+{
+    int i;
+
+    valid_pin(pin);
+    if (SIM_MAX_EVENTS == _nevents)
+        return -1;
+
+    /* keep sorted, stable for equal times */
+    for (i = _nevents; 0 < i && at < _events[i - 1].at; -- i)
+        _events[i] = _events[i - 1];
+
+    _events[i].at = at;
+    _events[i].pin = pin;
+    _events[i].value = value ? HIGH : LOW;
+    ++ _nevents;
+
+    apply_events();
+    return 0;
+}
+
+int sim_output(uint8_t pin)
+{
+    valid_pin(pin);
+    return _outputs[pin];
+}
+
+unsigned long sim_output_changes(uint8_t pin)
+{
+    valid_pin(pin);
+    return _changes[pin];
+}
+
+void sim_analog(uint8_t channel, int value)
+{
+    valid_pin(SIM_ANALOG_PIN0 + channel);
+    _analog[channel] = value;
+    _analog_fn[channel] = NULL;
+}
+
+void sim_analog_source(uint8_t channel, sim_analog_fn_t *fn, void *ctx)
+{
+    valid_pin(SIM_ANALOG_PIN0 + channel);
+    _analog_fn[channel] = fn;
+    _analog_ctx[channel] = ctx;
+}
+
+void sim_serial_attach(uint8_t tx_pin, sim_serial_peer_t *peer, void *ctx)
+{
+    sim_peer_t *p = lookup_peer(tx_pin);
+
+    if (NULL == p) {
+        if (SIM_MAX_SERIALS == _npeers) {
+            fprintf(stderr, "sim: too many serial peers\n");
+            abort();
+        }
+
+        p = &_peers[_npeers ++];
+        p->pin = tx_pin;
+        p->sent = 0;
+    }
+
+    p->peer = peer;
+    p->ctx = ctx;
+}
+
+int sim_serial_reply(uint8_t tx_pin, uint8_t c)
+{
+    int i;
+
+    for (i = 0; i < SIM_MAX_SERIALS; ++ i) {
+        if (NULL != _serials[i] && _serials[i]->tx_pin() == tx_pin)
+            return _serials[i]->receive(c);
+    }
+
+    return -1;
+}
+
+unsigned long sim_serial_sent(uint8_t tx_pin)
+{
+    sim_peer_t *p = lookup_peer(tx_pin);
+    return (NULL != p) ? p->sent : 0;
+}
+
+int sim_isr_attach(int vector, sim_isr_t *isr)
+{
+    /* PCINT0_vect goes with PCICR bit 0, and so on */
+    int i = vector - PCINT0_vect;
+    if (i < 0 || 3 <= i)
+        return -1;
+
+    _pcint_isrs[i] = isr;
+    return 0;
+}
+
+/* -- mock core ------------------------------------------------------------- */
+unsigned long millis()
+{
+    sim_advance(SIM_CLOCK_READ_US);
+    return (unsigned long) (_now / 1000);
+}
+
+unsigned long micros()
+{
+    sim_advance(SIM_CLOCK_READ_US);
+    return (unsigned long) _now;
+}
+
+void delay(unsigned long ms)
+{
+    sim_advance((sim_time_t) ms * 1000);
+}
+
+void delayMicroseconds(unsigned int us)
+{
+    sim_advance(us);
+}
+
+void pinMode(uint8_t pin, uint8_t mode)
+{
+    /* inputs with pull-ups read high until driven */
+    if (valid_pin(pin) && INPUT_PULLUP == mode)
+        set_input(pin, HIGH);
+}
+
+/* through the input register, as the core does */
+int digitalRead(uint8_t pin)
+{
+    valid_pin(pin);
+
+    uint8_t port = digitalPinToPort(pin);
+    uint8_t mask = digitalPinToBitMask(pin);
+
+    if (NOT_A_PIN == port)
+        return LOW;
+
+    return (*portInputRegister(port) & mask) ? HIGH : LOW;
+}
+
+void digitalWrite(uint8_t pin, uint8_t value)
+{
+    valid_pin(pin);
+
+    value = value ? HIGH : LOW;
+    if (value != _outputs[pin]) {
+        _outputs[pin] = value;
+        ++ _changes[pin];
+    }
+}
+
+int analogRead(uint8_t pin)
+{
+    /* channel numbers and A0.. pin numbers are both accepted */
+    uint8_t channel = (SIM_ANALOG_PIN0 <= pin) ? pin - SIM_ANALOG_PIN0 : pin;
+    valid_pin(SIM_ANALOG_PIN0 + channel);
+
+    /* a conversion takes about 100us */
+    sim_advance(100);
+
+    if (NULL != _analog_fn[channel])
+        return _analog_fn[channel](channel, _analog_ctx[channel]);
+
+    return _analog[channel];
+}
+
+/* -- mock SoftwareSerial --------------------------------------------------- */
+SoftwareSerial::SoftwareSerial(uint8_t rx_pin, uint8_t tx_pin)
+{
+    int i;
+
+    _tx_pin = tx_pin;
+    _rx_head = _rx_tail = 0;
+    _overflow = false;
+
+    for (i = 0; i < SIM_MAX_SERIALS && NULL != _serials[i]; ++ i)
+        ;
+
+    if (SIM_MAX_SERIALS == i) {
+        fprintf(stderr, "sim: too many serial ports\n");
+        abort();
+    }
+
+    _serials[i] = this;
+}
+
+SoftwareSerial::~SoftwareSerial()
+{
+    int i;
+
+    for (i = 0; i < SIM_MAX_SERIALS; ++ i) {
+        if (this == _serials[i])
+            _serials[i] = NULL;
+    }
+}
+
+int SoftwareSerial::available()
+{
+    return (uint8_t) (_rx_head - _rx_tail);
+}
+
+int SoftwareSerial::peek()
+{
+    return (_rx_head != _rx_tail) ? _rx[_rx_tail % SIM_SERIAL_RX] : -1;
+}
+
+int SoftwareSerial::read()
+{
+    int c = peek();
+
+    if (0 <= c)
+        ++ _rx_tail;
+
+    return c;
+}
+
+size_t SoftwareSerial::write(uint8_t c)
+{
+    sim_peer_t *p = lookup_peer(_tx_pin);
+
+    sim_advance(SIM_SERIAL_BYTE_US);
+
+    if (NULL != p) {
+        ++ p->sent;
+        if (NULL != p->peer)
+            p->peer(_tx_pin, c, p->ctx);
+    }
+
+    return 1;
+}
+
+int SoftwareSerial::receive(uint8_t c)
+{
+    if (SIM_SERIAL_RX == (uint8_t) (_rx_head - _rx_tail)) {
+        _overflow = true;
+        return -1;
+    }
+
+    _rx[_rx_head % SIM_SERIAL_RX] = c;
+    ++ _rx_head;
+
+    return 0;
+}
@@ -0,0 +1,106 @@
+/**
+ * @file Sim.h
+ * @brief Host simulation harness: virtual clock, scripted pins and serial
+ *
+ * Copyright (C) 2013 Marco Pensallorto
+ * < marco DOT pensallorto AT gmail DOT com >
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+**/
+#ifndef SIM_H_DEFINED
+#define SIM_H_DEFINED
+
+#include <Arduino.h>
+
+/* The mock core (see Arduino.h) runs on a virtual clock, in
+   microseconds, which only moves when told to: by delay(), by serial
+   transfers, by a tiny amount on every clock read (so that busy waits
+   end), and by the harness between two passes of loop() (see sim_idle).
+   Runs are deterministic, and hours of sketch time take seconds.
+
+   Inputs are scripted: digital levels are set now or at a given time,
+   analog channels read a constant or a callback (e.g. a plant model).
+   Bytes sent on a SoftwareSerial go to a peer callback (e.g. a device
+   model, see SimLCD.h), which may answer. */
+
+/* virtual time taken by each millis() or micros() call */
+const unsigned long SIM_CLOCK_READ_US = 1;
+
+/* virtual time taken by a SoftwareSerial byte, 10 bits at 9600 baud.
+   SoftwareSerial sends with interrupts off, so does the mock */
+const unsigned long SIM_SERIAL_BYTE_US = 1042;
+
+/* digital pins 0 to 13, then analog pins A0 (14) to A5 (19) */
+const int SIM_PINS = 20;
+const int SIM_ANALOG_PIN0 = 14;
+
+const int SIM_MAX_EVENTS = 64;
+const int SIM_MAX_SERIALS = 2;
+const int SIM_SERIAL_RX = 64;
+
+/* -- custom typedefs ------------------------------------------------------- */
+typedef unsigned long long sim_time_t; /* us */
+
+/* returns the reading of an analog channel */
+typedef int sim_analog_fn_t(uint8_t channel, void *ctx);
+
+/* gets a byte sent on a serial port */
+typedef void sim_serial_peer_t(uint8_t tx_pin, uint8_t c, void *ctx);
+
+/* -- public interface ------------------------------------------------------ */
+
+/** returns the virtual time (us) */
+sim_time_t sim_now();
+
+/** moves the virtual clock forward, applying scripted changes on the
+    way */
+void sim_advance(sim_time_t us);
+
+/** moves the virtual clock forward by up to us, stopping at the next
+    scripted change. To be invoked between two passes of loop(), e.g.
+    with the time left before the next timer is due */
+void sim_idle(sim_time_t us);
+
+/** sets the level of a digital input */
+void sim_digital(uint8_t pin, int value);
+
+/** schedules a digital input change at time at (us). Returns 0 if
+    succesful, -1 if the script is full */
+int sim_digital_at(sim_time_t at, uint8_t pin, int value);
+
+/** returns the level last written to a pin */
+int sim_output(uint8_t pin);
+
+/** returns the number of level changes written to a pin so far */
+unsigned long sim_output_changes(uint8_t pin);
+
+/** sets a constant analog reading, 0 to 1023 */
+void sim_analog(uint8_t channel, int value);
+
+/** sets a callback returning the analog readings of a channel */
+void sim_analog_source(uint8_t channel, sim_analog_fn_t *fn, void *ctx);
+
+/** connects a peer to the SoftwareSerial transmitting on tx_pin */
+void sim_serial_attach(uint8_t tx_pin, sim_serial_peer_t *peer, void *ctx);
+
+/** sends a byte to the SoftwareSerial transmitting on tx_pin, e.g. from
+    its peer. Returns 0 if succesful, -1 if not found or full */
+int sim_serial_reply(uint8_t tx_pin, uint8_t c);
+
+/** returns the number of bytes sent on tx_pin so far */
+unsigned long sim_serial_sent(uint8_t tx_pin);
+
+#endif
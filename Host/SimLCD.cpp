@@ -0,0 +1,119 @@
+/**
+ * @file SimLCD.cpp
+ * @brief Serial LCD module model implementation
+ *
+ * Copyright (C) 2013 Marco Pensallorto
+ * < marco DOT pensallorto AT gmail DOT com >
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+**/
+#include <SimLCD.h>
+#include <SerialLCD.h>
+
+/* protocol states */
+enum {
+    LCD_COMMAND,   /* waiting for a header */
+    LCD_CONTROL,   /* got a control header, waiting for the command */
+    LCD_COLUMN,    /* cursor handshake, waiting for the column */
+    LCD_ROW,       /* cursor handshake, waiting for the row */
+    LCD_TEXT,      /* got a char header, characters follow */
+};
+
+/* -- static functions ------------------------------------------------------ */
+static void clear(sim_lcd_t *lcd)
+{
+    int row;
+
+    for (row = 0; row < SIM_LCD_ROWS; ++ row) {
+        memset(lcd->rows[row], ' ', SIM_LCD_COLS);
+        lcd->rows[row][SIM_LCD_COLS] = '\0';
+    }
+
+    lcd->col = lcd->row = 0;
+}
+
+static void reply(sim_lcd_t *lcd, uint8_t tx_pin, uint8_t c)
+{
+    ++ lcd->acks;
+    sim_serial_reply(tx_pin, c);
+}
+
+/** -- public functions ----------------------------------------------------- */
+void sim_lcd_init(sim_lcd_t *lcd, uint8_t tx_pin)
+{
+    clear(lcd);
+
+    lcd->state = LCD_COMMAND;
+    lcd->acks = lcd->bytes = 0;
+    lcd->chars = lcd->frames = 0;
+
+    sim_serial_attach(tx_pin, sim_lcd_receive, lcd);
+}
+
+void sim_lcd_receive(uint8_t tx_pin, uint8_t c, void *ctx)
+{
+    sim_lcd_t *lcd = (sim_lcd_t *) ctx;
+
+    ++ lcd->bytes;
+
+    switch (lcd->state) {
+    case LCD_CONTROL:
+        lcd->state = LCD_COMMAND;
+
+        if (SLCD_CURSOR_HEADER == c) {
+            reply(lcd, tx_pin, SLCD_CURSOR_ACK);
+            lcd->state = LCD_COLUMN;
+        }
+        else if (SLCD_CLEAR_DISPLAY == c)
+            clear(lcd);
+        else if (SLCD_RETURN_HOME == c)
+            lcd->col = lcd->row = 0;
+
+        /* other commands do not change the contents */
+        return;
+
+    case LCD_COLUMN:
+        lcd->col = c;
+        lcd->state = LCD_ROW;
+        return;
+
+    case LCD_ROW:
+        lcd->row = c;
+        lcd->state = LCD_COMMAND;
+        return;
+
+    default:
+        break;
+    }
+
+    /* headers, also within text */
+    if (SLCD_CONTROL_HEADER == c)
+        lcd->state = LCD_CONTROL;
+    else if (SLCD_CHAR_HEADER == c) {
+        lcd->state = LCD_TEXT;
+        ++ lcd->frames;
+    }
+    else if (SLCD_INIT_ACK == c && LCD_COMMAND == lcd->state)
+        reply(lcd, tx_pin, SLCD_INIT_DONE);
+    else if (LCD_TEXT == lcd->state) {
+        if (lcd->row < SIM_LCD_ROWS && lcd->col < SIM_LCD_COLS)
+            lcd->rows[lcd->row][lcd->col] = c;
+
+        ++ lcd->chars;
+        /* the controller RAM is wider than the display */
+        ++ lcd->col;
+    }
+}
@@ -0,0 +1,66 @@
+/**
+ * @file SimLCD.h
+ * @brief Serial LCD module model, for the host simulation harness
+ *
+ * Copyright (C) 2013 Marco Pensallorto
+ * < marco DOT pensallorto AT gmail DOT com >
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+**/
+#ifndef SIM_LCD_H_DEFINED
+#define SIM_LCD_H_DEFINED
+
+#include <Sim.h>
+
+/* A 2x16 serial LCD module (see SerialLCD.h) as a serial peer (see
+   sim_serial_attach): it answers the init and cursor handshakes, and
+   keeps the characters on display. */
+
+const int SIM_LCD_ROWS = 2;
+const int SIM_LCD_COLS = 16;
+
+/* -- custom typedefs ------------------------------------------------------- */
+typedef struct {
+
+    /** display contents, one nul-terminated string per row */
+    char rows[SIM_LCD_ROWS][SIM_LCD_COLS + 1];
+
+    /** cursor */
+    uint8_t col;
+    uint8_t row;
+
+    /** (reserved) protocol state */
+    uint8_t state;
+
+    /** handshakes answered, bytes received */
+    unsigned long acks;
+    unsigned long bytes;
+
+    /** characters received, and char headers they came under */
+    unsigned long chars;
+    unsigned long frames;
+} sim_lcd_t;
+
+/* -- public interface ------------------------------------------------------ */
+
+/** initializes a blank display, and connects it to the SoftwareSerial
+    transmitting on tx_pin */
+void sim_lcd_init(sim_lcd_t *lcd, uint8_t tx_pin);
+
+/** serial peer function, see sim_serial_attach */
+void sim_lcd_receive(uint8_t tx_pin, uint8_t c, void *ctx);
+
+#endif
@@ -0,0 +1,66 @@
+/**
+ * @file SimRoom.cpp
+ * @brief Room thermal model implementation
+ *
+ * Copyright (C) 2013 Marco Pensallorto
+ * < marco DOT pensallorto AT gmail DOT com >
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+**/
+#include <SimRoom.h>
+
+/** -- public functions ----------------------------------------------------- */
+void sim_room_init(sim_room_t *room, double ambient, uint8_t heater_pin)
+{
+    memset(room, 0, sizeof(sim_room_t));
+
+    room->room = room->heater = room->ambient = ambient;
+    room->heater_pin = heater_pin;
+    room->last = sim_now();
+}
+
+void sim_room_update(sim_room_t *room)
+{
+    int on = sim_output(room->heater_pin);
+
+    while (room->last + SIM_ROOM_STEP <= sim_now()) {
+        double dt = SIM_ROOM_STEP / 1e6;
+        double heat = SIM_ROOM_COUPLING * (room->heater - room->room);
+
+        room->heater += dt * ((room->ambient +
+                               (on ? SIM_ROOM_HEATER_POWER : 0)) -
+                              room->heater) / SIM_ROOM_HEATER_TAU;
+        room->room += dt * (heat - (room->room - room->ambient)) /
+            SIM_ROOM_TAU;
+
+        if (on)
+            room->on += SIM_ROOM_STEP;
+        room->last += SIM_ROOM_STEP;
+    }
+}
+
+int sim_room_adc(uint8_t channel, void *ctx)
+{
+    sim_room_t *room = (sim_room_t *) ctx;
+    double kelvin, r;
+
+    sim_room_update(room);
+
+    kelvin = room->room + 273.15;
+    r = 10000.0 * exp(3975 * (1 / kelvin - 1 / 298.15));
+
+    return (int) lround(1023 * 10000.0 / (r + 10000.0));
+}
@@ -0,0 +1,68 @@
+/**
+ * @file SimRoom.h
+ * @brief Room thermal model, for the host simulation harness
+ *
+ * Copyright (C) 2013 Marco Pensallorto
+ * < marco DOT pensallorto AT gmail DOT com >
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+**/
+#ifndef SIM_ROOM_H_DEFINED
+#define SIM_ROOM_H_DEFINED
+
+#include <Sim.h>
+
+/* A room heated by an electric heater, as two first order lags: the
+   heater warms up towards its full power temperature while on, the room
+   exchanges heat with the heater and with the outside. A digital output
+   drives the heater, the room temperature drives the reading of a B =
+   3975, 10k thermistor divider (see sim_room_adc). */
+
+const double SIM_ROOM_HEATER_POWER = 60.0; /* over ambient, at equilibrium */
+const double SIM_ROOM_HEATER_TAU = 180.0;  /* s */
+const double SIM_ROOM_TAU = 900.0;         /* s */
+const double SIM_ROOM_COUPLING = 0.5;
+const sim_time_t SIM_ROOM_STEP = 100000;   /* us */
+
+/* -- custom typedefs ------------------------------------------------------- */
+typedef struct {
+
+    /** temperatures (C) */
+    double room;
+    double heater;
+    double ambient;
+
+    /** pin driving the heater */
+    uint8_t heater_pin;
+
+    /** time the model was last brought up to date, and time spent on */
+    sim_time_t last;
+    sim_time_t on;
+} sim_room_t;
+
+/* -- public interface ------------------------------------------------------ */
+
+/** initializes a room at ambient temperature, heater off */
+void sim_room_init(sim_room_t *room, double ambient, uint8_t heater_pin);
+
+/** brings the model up to the virtual time */
+void sim_room_update(sim_room_t *room);
+
+/** analog source function (see sim_analog_source), returns the
+    thermistor reading for a sim_room_t */
+int sim_room_adc(uint8_t channel, void *ctx);
+
+#endif
@@ -0,0 +1,63 @@
+/**
+ * @file SoftwareSerial.h
+ * @brief Mock SoftwareSerial, for native host builds (see Sim.h)
+ *
+ * Copyright (C) 2013 Marco Pensallorto
+ * < marco DOT pensallorto AT gmail DOT com >
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+**/
+#ifndef SOFTWARE_SERIAL_H_DEFINED
+#define SOFTWARE_SERIAL_H_DEFINED
+
+#include <Sim.h>
+
+/* Bytes written take SIM_SERIAL_BYTE_US of virtual time each, then go to
+   the peer attached to the tx pin (see sim_serial_attach). Bytes sent
+   back by the peer are queued for read(). */
+class SoftwareSerial : public Print {
+public:
+    SoftwareSerial(uint8_t rx_pin, uint8_t tx_pin);
+    virtual ~SoftwareSerial();
+
+    void begin(long speed) {}
+    void end() {}
+    bool listen() { return true; }
+    bool isListening() { return true; }
+    bool overflow() { return _overflow; }
+
+    int available();
+    int peek();
+    int read();
+    void flush() {}
+
+    virtual size_t write(uint8_t c);
+    using Print::write;
+
+    /* (reserved) harness side, see Sim.h */
+    uint8_t tx_pin() { return _tx_pin; }
+    int receive(uint8_t c);
+
+private:
+    uint8_t _tx_pin;
+
+    uint8_t _rx[SIM_SERIAL_RX];
+    uint8_t _rx_head;
+    uint8_t _rx_tail;
+    bool _overflow;
+};
+
+#endif
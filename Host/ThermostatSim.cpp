@@ -0,0 +1,128 @@
+/**
+ * @file ThermostatSim.cpp
+ * @brief Runs the Thermostat sketch on the host, against a room model
+ *
+ * Copyright (C) 2013 Marco Pensallorto
+ * < marco DOT pensallorto AT gmail DOT com >
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+**/
+#include <Sim.h>
+#include <SimLCD.h>
+#include <SimRoom.h>
+#include <Timers.h>
+
+#include <unistd.h>
+
+/* usage: thermostat-sim [-t seconds] [-a ambient] [-r seconds]
+                         [-c pin@seconds[:ms]]...
+
+   Runs the sketch for -t seconds of virtual time (default 7200), in a
+   room at -a Celsius degrees (default 15), printing the room, the relay
+   and the display every -r seconds (default 60). -c clicks a button:
+   pin goes high at the given time, for ms milliseconds (default 200). */
+
+/* sketch entry points, see Thermostat.ino */
+void setup();
+void loop();
+
+/* pins, see Thermostat.ino */
+static const uint8_t ai_thermistor = 0;
+static const uint8_t do_actuate = 4;
+static const uint8_t slcd_tx_pin = 12;
+
+/* -- main ------------------------------------------------------------------ */
+static int schedule_click(const char *arg)
+{
+    int pin, ms = 200;
+    double at;
+
+    if (sscanf(arg, "%d@%lf:%d", &pin, &at, &ms) < 2)
+        return -1;
+
+    if (0 != sim_digital_at((sim_time_t) (at * 1e6), pin, HIGH) ||
+        0 != sim_digital_at((sim_time_t) (at * 1e6) + ms * 1000ULL, pin, LOW))
+        return -1;
+
+    return 0;
+}
+
+static void report(sim_room_t *room, sim_lcd_t *lcd)
+{
+    unsigned long secs = (unsigned long) (sim_now() / 1000000);
+
+    printf("%02lu:%02lu:%02lu  room %6.2f  relay %-3s  [%s|%s]\n",
+           secs / 3600, secs / 60 % 60, secs % 60, room->room,
+           sim_output(do_actuate) ? "on" : "off",
+           lcd->rows[0], lcd->rows[1]);
+}
+
+int main(int argc, char *argv[])
+{
+    double seconds = 7200, every = 60, ambient = 15;
+    sim_room_t room;
+    sim_lcd_t lcd;
+    sim_time_t end, next_report;
+    int opt;
+
+    while (-1 != (opt = getopt(argc, argv, "t:a:r:c:"))) {
+        switch (opt) {
+        case 't': seconds = atof(optarg); break;
+        case 'a': ambient = atof(optarg); break;
+        case 'r': every = atof(optarg); break;
+        case 'c':
+            if (0 == schedule_click(optarg))
+                break;
+            /* fallthrough */
+        default:
+            fprintf(stderr, "usage: %s [-t seconds] [-a ambient] "
+                    "[-r seconds] [-c pin@seconds[:ms]]...\n", argv[0]);
+            return 1;
+        }
+    }
+
+    sim_room_init(&room, ambient, do_actuate);
+    sim_lcd_init(&lcd, slcd_tx_pin);
+    sim_analog_source(ai_thermistor, sim_room_adc, &room);
+
+    end = (sim_time_t) (seconds * 1e6);
+    next_report = 0;
+
+    setup();
+    while (sim_now() < end) {
+        ticks_t left;
+
+        loop();
+
+        if (next_report <= sim_now()) {
+            sim_room_update(&room);
+            report(&room, &lcd);
+            next_report += (sim_time_t) (every * 1e6);
+        }
+
+        /* sleep until the next timer, as timers_idle() would */
+        left = timers_next_deadline();
+        sim_idle((left < 1000) ? left * 1000ULL : 1000000ULL);
+    }
+
+    sim_room_update(&room);
+    printf("relay on %.1f%% of the time, %lu switches; "
+           "%lu bytes sent to the LCD\n",
+           100.0 * room.on / sim_now(), sim_output_changes(do_actuate),
+           lcd.bytes);
+
+    return 0;
+}
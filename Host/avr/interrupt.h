@@ -0,0 +1,47 @@
+/**
+ * @file interrupt.h
+ * @brief Mock avr/interrupt.h, for native host builds (see Sim.h)
+ *
+ * Copyright (C) 2013 Marco Pensallorto
+ * < marco DOT pensallorto AT gmail DOT com >
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+**/
+#ifndef AVR_INTERRUPT_H_DEFINED
+#define AVR_INTERRUPT_H_DEFINED
+
+#include <Arduino.h>
+
+/* Only the pin change vectors of an Uno exist. ISR() attaches its body
+   to the vector before main() runs, the harness calls it on pin changes
+   (see Arduino.h), that is between two passes of loop(). */
+#define PCINT0_vect 3
+#define PCINT1_vect 4
+#define PCINT2_vect 5
+
+typedef void sim_isr_t();
+
+/** attaches isr to vector. Returns 0 if succesful, -1 if not a pin change
+    vector */
+int sim_isr_attach(int vector, sim_isr_t *isr);
+
+#define ISR(vector)                                                     \
+    static void sim_isr_##vector();                                     \
+    static int sim_isr_attached_##vector =                              \
+        sim_isr_attach(vector, sim_isr_##vector);                       \
+    static void sim_isr_##vector()
+
+#endif
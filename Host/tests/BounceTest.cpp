@@ -0,0 +1,265 @@
+/**
+ * @file BounceTest.cpp
+ * @brief Host tests of the debouncer banks on bouncing switches
+ *
+ * Copyright (C) 2013 Marco Pensallorto
+ * < marco DOT pensallorto AT gmail DOT com >
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+**/
+#include <Check.h>
+#include <Sim.h>
+#include <Timers.h>
+#include <DebouncerBank.h>
+#include <VerticalDebouncerBank.h>
+
+/* Synthetic traces of a tactile switch, bouncing for a few ms on press
+   and release, are replayed on a pin of each bank. The program is built
+   twice: polled from a permanent timer, and with DEBOUNCE_USE_PCINT
+   (build/pcint), polled only after a change on the emulated pin change
+   interrupts (see Arduino.h). Both must report the same events. */
+
+#ifdef DEBOUNCE_USE_PCINT
+static const char *MODE = "pcint";
+#else
+static const char *MODE = "polled";
+#endif
+
+const ticks_t RESOLUTION = 10; /* ms */
+const ticks_t CLICK = 3;
+const ticks_t HOLD = 20;
+
+/* pins on two different ports */
+const uint8_t PIN = 2;
+const uint8_t VPIN = 9;
+
+const int MAX_EVENTS = 16;
+
+typedef struct {
+    debouncer_state_t state[MAX_EVENTS];
+    unsigned long at[MAX_EVENTS];
+    int count;
+} events_t;
+
+static int record(deb_id_t unused, debouncer_state_t state, void *ctx)
+{
+    events_t *events = (events_t *) ctx;
+
+    if (events->count < MAX_EVENTS) {
+        events->state[events->count] = state;
+        events->at[events->count] = millis();
+    }
+
+    ++ events->count;
+    return 0;
+}
+
+static DebouncerBank<4> bank;
+static VerticalDebouncerBank<> vbank;
+
+/* -- traces ---------------------------------------------------------------- */
+typedef struct {
+    unsigned long us;
+    uint8_t level;
+} edge_t;
+
+typedef struct {
+    const char *name;
+    const edge_t *edges;
+    int n;
+
+    /* events expected, up to DEB_IDLE */
+    debouncer_state_t expected[MAX_EVENTS];
+} trace_t;
+
+/* a click: 1.8 ms of bounce on press, 120 ms down, 2.6 ms on release */
+static const edge_t click_edges[] = {
+    {      0, 1 }, {    150, 0 }, {    400, 1 }, {    520, 0 },
+    {    900, 1 }, {   1100, 0 }, {   1800, 1 },
+    { 120000, 0 }, { 120300, 1 }, { 120700, 0 }, { 121500, 1 },
+    { 122600, 0 },
+};
+
+/* noise, spikes far shorter than a sample period */
+static const edge_t glitch_edges[] = {
+    {    300, 1 }, {    500, 0 }, {   5300, 1 }, {   5450, 0 },
+    {  12400, 1 }, {  12500, 0 }, {  40300, 1 }, {  40700, 0 },
+};
+
+/* held for 450 ms, chattering on release for 8 ms as worn switches do */
+static const edge_t hold_edges[] = {
+    {      0, 1 }, {    200, 0 }, {    700, 1 }, {    800, 0 },
+    {   1300, 1 },
+    { 450000, 0 }, { 451000, 1 }, { 452500, 0 }, { 454000, 1 },
+    { 455000, 0 }, { 456500, 1 }, { 458000, 0 },
+};
+
+#define EDGES(e) e, (int) (sizeof(e) / sizeof(e[0]))
+
+static const trace_t traces[] = {
+    { "click", EDGES(click_edges), { DEB_CLICK, DEB_RELEASE } },
+    { "glitch", EDGES(glitch_edges), { DEB_IDLE } },
+    { "hold", EDGES(hold_edges),
+      { DEB_CLICK, DEB_HOLD, DEB_HOLD, DEB_RELEASE } },
+};
+
+/* -- scripts --------------------------------------------------------------- */
+
+/* runs loop() passes until ms, sleeping while no timer is active as
+   timers_idle() would, until a pin change */
+static void run(unsigned long ms)
+{
+    while (sim_now() < ms * 1000ULL) {
+        sim_time_t left, end = ms * 1000ULL - sim_now();
+
+        bank.wakeup();
+        vbank.wakeup();
+
+        timers_check();
+        left = timers_next_deadline();
+        sim_idle((left < end / 1000) ? left * 1000ULL : end);
+    }
+}
+
+/* replays edges on pin from ms on */
+static void replay(uint8_t pin, unsigned long ms, const edge_t *edges, int n)
+{
+    int i;
+
+    for (i = 0; i < n; ++ i)
+        CHECK(0 == sim_digital_at(ms * 1000ULL + edges[i].us, pin,
+                                  edges[i].level));
+}
+
+/* -- checks ---------------------------------------------------------------- */
+
+static void check_events(const char *name, const trace_t *trace,
+                         unsigned long t, events_t *ev)
+{
+    int i;
+
+    for (i = 0; DEB_IDLE != trace->expected[i]; ++ i)
+        CHECK(i < ev->count && trace->expected[i] == ev->state[i]);
+    CHECK(i == ev->count);
+
+    /* click samples after the first sample of the press */
+    if (0 < ev->count)
+        CHECK(t + (CLICK - 1) * RESOLUTION <= ev->at[0] &&
+              ev->at[0] <= t + (CLICK + 1) * RESOLUTION);
+
+    printf("  %s %s: %s, %d events", MODE, name, trace->name, ev->count);
+    if (0 < ev->count)
+        printf(", first after %lu ms", ev->at[0] - t);
+    printf("\n");
+}
+
+/* polling stops once the buttons are idle, with DEBOUNCE_USE_PCINT */
+static void check_polling()
+{
+#ifdef DEBOUNCE_USE_PCINT
+    CHECK((ticks_t) ~0UL == timers_next_deadline());
+#else
+    CHECK(timers_next_deadline() <= RESOLUTION);
+#endif
+}
+
+/* resumes the debouncer in ctx on RELEASE, from its handler */
+typedef struct {
+    VerticalDebouncerBank<> *bank;
+    deb_id_t id;
+} resumer_t;
+
+static int resume_on_release(deb_id_t unused, debouncer_state_t state,
+                             void *ctx)
+{
+    resumer_t *r = (resumer_t *) ctx;
+
+    if (DEB_RELEASE == state)
+        CHECK(0 == r->bank->resume(r->id));
+
+    return 0;
+}
+
+/* a button pressed while paused, and resumed by a handler as the last
+   other button is released: polling must go on to find it pressed */
+static void test_resume(unsigned long t)
+{
+    resumer_t r;
+    events_t ev;
+    deb_id_t a;
+
+    memset(&ev, 0, sizeof(ev));
+    r.bank = &vbank;
+    r.id = vbank.enable(record, 10, &ev);
+    CHECK(0 <= r.id);
+    CHECK(0 == vbank.pause(r.id));
+
+    a = vbank.enable(resume_on_release, 11, &r);
+    CHECK(0 <= a);
+
+    sim_digital_at((t + 50) * 1000ULL, 10, HIGH);
+    sim_digital_at((t + 100) * 1000ULL, 11, HIGH);
+    sim_digital_at((t + 200) * 1000ULL, 11, LOW);
+    sim_digital_at((t + 350) * 1000ULL, 10, LOW);
+    run(t + 1000);
+
+    CHECK(2 == ev.count);
+    CHECK(DEB_CLICK == ev.state[0] && DEB_RELEASE == ev.state[1]);
+    CHECK(ev.at[0] < t + 300);
+    check_polling();
+
+    CHECK(0 == vbank.disable(r.id) && 0 == vbank.disable(a));
+    if (0 < ev.count)
+        printf("  %s: resumed by a handler, CLICK after %lu ms\n",
+               MODE, ev.at[0] - t - 200);
+}
+
+/* -- main ------------------------------------------------------------------ */
+int main()
+{
+    events_t ev, vev;
+    unsigned long t = 1000;
+    unsigned i;
+
+    CHECK(0 == timers_init());
+    CHECK(0 == bank.init(RESOLUTION, CLICK, HOLD));
+    CHECK(0 == vbank.init(RESOLUTION, CLICK, HOLD));
+
+    CHECK(0 <= bank.enable(record, PIN, &ev));
+    CHECK(0 <= vbank.enable(record, VPIN, &vev));
+
+    for (i = 0; i < sizeof(traces) / sizeof(traces[0]); ++ i) {
+        const trace_t *trace = &traces[i];
+
+        memset(&ev, 0, sizeof(ev));
+        memset(&vev, 0, sizeof(vev));
+
+        /* on the same edges, at different sample phases */
+        replay(PIN, t, trace->edges, trace->n);
+        replay(VPIN, t + 3, trace->edges, trace->n);
+        run(t + 1000);
+
+        check_events("bank", trace, t, &ev);
+        check_events("vertical bank", trace, t + 3, &vev);
+        check_polling();
+
+        t += 1000;
+    }
+
+    test_resume(t);
+
+    return check_status();
+}
@@ -0,0 +1,306 @@
+/**
+ * @file ControlTest.cpp
+ * @brief Host tests of the Control library, on the room model
+ *
+ * Copyright (C) 2013 Marco Pensallorto
+ * < marco DOT pensallorto AT gmail DOT com >
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+**/
+#include <Check.h>
+#include <Sim.h>
+#include <SimRoom.h>
+#include <Control.h>
+#include <Thermistor.h>
+
+/* Each law heats the room model (see SimRoom.h) from 15 C to a 25 C
+   setpoint, updated every second through a relay, with the timing and
+   gains of the Thermostat sketch. Overshoot and settling time within
+   +/- 0.3 C are compared. The fixed-point hysteresis is then checked
+   against the floating point one it replaced. */
+
+const double AMBIENT = 15.0;
+const temp_t GOAL = 2500;
+const double BAND = 0.3;
+const long DURATION = 3 * 3600;     /* s */
+
+const uint8_t heater_pin = 4;
+
+/* see Thermostat.ino */
+const temp_t HYST_OFFSET = 20;
+const int PID_KP = 1280;
+const int PID_KI = 1;
+const int PID_KD = 25600;
+const unsigned long RELAY_WINDOW  = 30000;
+const unsigned long RELAY_MIN_ON  = 3000;
+const unsigned long RELAY_MIN_OFF = 3000;
+
+typedef struct {
+
+    /** highest temperature over the setpoint (C) */
+    double overshoot;
+
+    /** time to enter the band for good (s), -1 if never */
+    long settling;
+
+    /** relay switches */
+    unsigned long switches;
+} step_response_t;
+
+/* -- step ------------------------------------------------------------------ */
+static step_response_t step(control_law_t *law)
+{
+    step_response_t res = { 0, 0, 0 };
+    unsigned long switches = sim_output_changes(heater_pin);
+    control_relay_t relay;
+    sim_room_t room;
+    double goal = GOAL / 100.0;
+    long t;
+
+    sim_room_init(&room, AMBIENT, heater_pin);
+    control_relay_init(&relay, heater_pin, RELAY_WINDOW, RELAY_MIN_ON,
+                       RELAY_MIN_OFF);
+
+    for (t = 0; t < DURATION; ++ t) {
+        /* the sensor as the sketch reads it, through the table */
+        temp_t curr = thermistor_centi(sim_room_adc(0, &room) <<
+                                       THERMISTOR_FRAC_BITS);
+
+        control_relay_update(&relay, millis(), control_update(law, curr,
+                                                              GOAL));
+        sim_advance(1000000);
+        sim_room_update(&room);
+
+        if (res.overshoot < room.room - goal)
+            res.overshoot = room.room - goal;
+
+        if (BAND < fabs(room.room - goal))
+            res.settling = t + 1;
+    }
+
+    /* still out in the last ten minutes, it never settled */
+    if (DURATION - 600 < res.settling)
+        res.settling = -1;
+
+    res.switches = sim_output_changes(heater_pin) - switches;
+    return res;
+}
+
+static void report(const char *name, step_response_t *res)
+{
+    printf("  %-10s overshoot %.2f C, ", name, res->overshoot);
+    if (res->settling < 0)
+        printf("never settles within %.1f C", BAND);
+    else
+        printf("settles within %.1f C in %ld min", BAND, res->settling / 60);
+    printf(", %lu relay switches\n", res->switches);
+}
+
+/* -- fixed point ----------------------------------------------------------- */
+
+/* The hysteresis and the setpoint buttons as the sketch had them before
+   temp_t, in floating point: readings in C, a .2 C offset and .5 C
+   steps between 0 and 40 C. The fixed-point path must make the same
+   decisions on the same readings. */
+typedef struct {
+    double goal;
+    int on;
+} float_path_t;
+
+static int float_hysteresis(float_path_t *f, double curr)
+{
+    if (! f->on) {
+        if (curr < f->goal - .2)
+            f->on = 1;
+    }
+    else if (f->goal + .2 < curr)
+        f->on = 0;
+
+    return f->on;
+}
+
+static void float_button(float_path_t *f, double increment, double limit)
+{
+    double tmp = f->goal + increment;
+
+    if ((0 < increment) ? (tmp <= limit) : (limit <= tmp))
+        f->goal = tmp;
+}
+
+/* see thermal_button_callback */
+static void fixed_button(temp_t *goal, temp_t increment, temp_t limit)
+{
+    temp_t tmp = temp_add(*goal, increment);
+
+    if ((0 < increment) ? (tmp <= limit) : (limit <= tmp))
+        *goal = tmp;
+}
+
+typedef struct {
+    float_path_t f;
+    control_hysteresis_t hyst;
+    temp_t goal;
+    unsigned long mismatches;
+} paths_t;
+
+static void paths_init(paths_t *p)
+{
+    memset(p, 0, sizeof(*p));
+    p->f.goal = 25.0;
+    p->goal = GOAL;
+    control_hysteresis_init(&p->hyst, HYST_OFFSET);
+}
+
+/* feeds a temperature, and a button press (-1, 0 or 1), to both paths.
+   Returns the relay decision */
+static int paths_step(paths_t *p, temp_t curr, int press)
+{
+    int on, fon;
+
+    if (0 < press) {
+        float_button(&p->f, .5, 40.0);
+        fixed_button(&p->goal, 50, 4000);
+    }
+    else if (press < 0) {
+        float_button(&p->f, -.5, 0.0);
+        fixed_button(&p->goal, -50, 0);
+    }
+
+    /* the float path read the table too, see the sketch before temp_t */
+    fon = float_hysteresis(&p->f, curr / 100.0);
+    on = (0 < control_hysteresis(&p->hyst, curr, p->goal));
+
+    if (on != fon || p->goal != lround(p->f.goal * 100))
+        ++ p->mismatches;
+
+    return on;
+}
+
+/* the reading of the sensor, through the table */
+static temp_t reading(int adc)
+{
+    return thermistor_centi((long) adc << THERMISTOR_FRAC_BITS);
+}
+
+/* every temperature from -10 to 60 C, up and down, around every
+   setpoint: from 25 C down to 0, then up to 40 */
+static unsigned long sweep()
+{
+    paths_t p;
+    int curr, k;
+
+    paths_init(&p);
+    for (k = 0; k < 50 + 80; ++ k) {
+        for (curr = -1000; curr <= 6000; ++ curr)
+            paths_step(&p, curr, 0);
+        for (curr = 6000; -1000 <= curr; -- curr)
+            paths_step(&p, curr, 0);
+
+        paths_step(&p, 2500, (k < 50) ? -1 : 1);
+    }
+
+    CHECK(4000 == p.goal);
+    return p.mismatches;
+}
+
+/* the room model run by the fixed-point path for 6 hours, a setpoint
+   change every 20 minutes, the float path on the same readings */
+static unsigned long room_trace()
+{
+    control_relay_t relay;
+    sim_room_t room;
+    paths_t p;
+    long t;
+
+    paths_init(&p);
+    sim_room_init(&room, AMBIENT, heater_pin);
+    control_relay_init(&relay, heater_pin, RELAY_WINDOW, RELAY_MIN_ON,
+                       RELAY_MIN_OFF);
+
+    for (t = 0; t < 6 * 3600; ++ t) {
+        int press = (0 == t % 1200) ? ((t / 1200) % 3) - 1 : 0;
+        int on = paths_step(&p, reading(sim_room_adc(0, &room)), press);
+
+        control_relay_update(&relay, millis(), on ? CONTROL_DUTY_MAX : 0);
+        sim_advance(1000000);
+        sim_room_update(&room);
+    }
+
+    return p.mismatches;
+}
+
+/* random walks of the reading, random presses */
+static unsigned long random_traces(int traces, int steps)
+{
+    unsigned long mismatches = 0;
+    paths_t p;
+    int i, j;
+
+    srand(2013);
+    for (i = 0; i < traces; ++ i) {
+        int adc = 1 + rand() % 1022;
+
+        paths_init(&p);
+        for (j = 0; j < steps; ++ j) {
+            int press = (0 == rand() % 50) ? ((rand() & 1) ? 1 : -1) : 0;
+
+            adc += rand() % 7 - 3;
+            adc = (adc < 1) ? 1 : (1022 < adc) ? 1022 : adc;
+            paths_step(&p, reading(adc), press);
+        }
+
+        mismatches += p.mismatches;
+    }
+
+    return mismatches;
+}
+
+/* -- main ------------------------------------------------------------------ */
+int main()
+{
+    control_hysteresis_t hysteresis;
+    control_pid_t pid;
+    control_law_t law;
+    step_response_t hyst_res, pid_res;
+
+    control_hysteresis_init(&hysteresis, HYST_OFFSET);
+    law.update = control_hysteresis;
+    law.state = &hysteresis;
+    hyst_res = step(&law);
+
+    control_pid_init(&pid, PID_KP, PID_KI, PID_KD);
+    law.update = control_pid;
+    law.state = &pid;
+    pid_res = step(&law);
+
+    report("hysteresis", &hyst_res);
+    report("PID", &pid_res);
+
+    CHECK(pid_res.overshoot < hyst_res.overshoot);
+    CHECK(0 <= pid_res.settling && pid_res.settling < 3600);
+
+    /* the relay honours its minimum times */
+    CHECK(pid_res.switches <= DURATION / (RELAY_MIN_ON / 1000));
+
+    /* fixed and float point decide alike */
+    CHECK(0 == sweep());
+    CHECK(0 == room_trace());
+    CHECK(0 == random_traces(2000, 5000));
+    printf("  fixed point: same relay decisions and setpoints as float on "
+           "every reading\n");
+
+    return check_status();
+}
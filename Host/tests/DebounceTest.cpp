@@ -0,0 +1,433 @@
+/**
+ * @file DebounceTest.cpp
+ * @brief Host tests of the button events of the debouncer banks
+ *
+ * Copyright (C) 2013 Marco Pensallorto
+ * < marco DOT pensallorto AT gmail DOT com >
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+**/
+#include <Check.h>
+#include <Sim.h>
+#include <Timers.h>
+#include <DebouncerBank.h>
+#include <VerticalDebouncerBank.h>
+
+/* Both banks debounce two buttons, one with the default timing and one
+   with a double click window, pressed by scripted pins. Events are
+   recorded along with the time of the sample that triggered them. Two
+   more banks then check disable, pause and resume, and sampling by
+   port is timed against digitalRead(). */
+
+const ticks_t RESOLUTION = 10; /* ms */
+const ticks_t CLICK = 3;
+const ticks_t HOLD = 20;
+
+/* HOLD as the default, DOUBLE_CLICK within 15 samples */
+const debounce_timing_t windowed = { CLICK, HOLD, HOLD, HOLD, 15 };
+
+const int MAX_EVENTS = 32;
+
+typedef struct {
+    debouncer_state_t state[MAX_EVENTS];
+    unsigned long at[MAX_EVENTS];
+    int count;
+} events_t;
+
+static int record(deb_id_t unused, debouncer_state_t state, void *ctx)
+{
+    events_t *events = (events_t *) ctx;
+
+    if (events->count < MAX_EVENTS) {
+        events->state[events->count] = state;
+        events->at[events->count] = millis();
+    }
+
+    ++ events->count;
+    return 0;
+}
+
+/* -- scripts --------------------------------------------------------------- */
+
+/* presses pin from ms on, for len ms */
+static void press(uint8_t pin, unsigned long ms, unsigned long len)
+{
+    sim_digital_at(ms * 1000ULL, pin, HIGH);
+    sim_digital_at((ms + len) * 1000ULL, pin, LOW);
+}
+
+/* runs the timers until ms */
+static void run(unsigned long ms)
+{
+    while (sim_now() < ms * 1000ULL) {
+        ticks_t left;
+
+        timers_check();
+        left = timers_next_deadline();
+        sim_idle((left < 1000) ? left * 1000ULL : 1000000ULL);
+    }
+}
+
+/* -- checks ---------------------------------------------------------------- */
+
+/* a long press: CLICK after click samples, HOLD on the hold-th high
+   sample counting from the first, then RELEASE */
+static void check_plain(const char *name, events_t *ev)
+{
+    CHECK(4 <= ev->count);
+    CHECK(DEB_CLICK == ev->state[0] && DEB_HOLD == ev->state[1]);
+    CHECK((HOLD - CLICK) * RESOLUTION == ev->at[1] - ev->at[0]);
+    CHECK(DEB_RELEASE == ev->state[ev->count - 1]);
+
+    printf("  %s: HOLD %lu ms after CLICK\n", name, ev->at[1] - ev->at[0]);
+}
+
+/* a click, a double click and a long press with a double click window */
+static void check_windowed(const char *name, events_t *ev)
+{
+    int i;
+
+    /* the single click comes once the window is over, button up */
+    CHECK(DEB_CLICK == ev->state[0]);
+    CHECK(1000 + 150 <= ev->at[0] && ev->at[0] < 2000);
+
+    /* no CLICK ahead of the DOUBLE_CLICK */
+    CHECK(DEB_DOUBLE_CLICK == ev->state[1] && 2000 < ev->at[1]);
+    CHECK(DEB_RELEASE == ev->state[2] && ev->at[2] < 3000);
+
+    /* held: no CLICK at all, HOLD repeats and RELEASE */
+    CHECK(DEB_HOLD == ev->state[3] && 3000 < ev->at[3]);
+    for (i = 4; i < ev->count - 1; ++ i)
+        CHECK(DEB_HOLD == ev->state[i]);
+    CHECK(DEB_RELEASE == ev->state[ev->count - 1]);
+
+    printf("  %s: CLICK %lu ms after the release, %d events in all\n",
+           name, ev->at[0] - 1000, ev->count);
+}
+
+/* -- slots ----------------------------------------------------------------- */
+
+/* the id of a disabled debouncer is stale for good: its slot comes back
+   with a new generation, which the old id does not reach */
+template <class Bank>
+static void test_ids(const char *name, Bank *bank)
+{
+    unsigned long t = millis();
+    events_t ev;
+    deb_id_t a, b;
+
+    memset(&ev, 0, sizeof(ev));
+
+    a = bank->enable(record, 6, &ev);
+    CHECK(0 <= a);
+    CHECK(0 == bank->disable(a));
+    CHECK(-1 == bank->disable(a));
+    CHECK(-1 == bank->pause(a) && -1 == bank->resume(a));
+
+    b = bank->enable(record, 6, &ev);
+    CHECK(0 <= b && a != b);
+    CHECK(debounce_id_index(a, 32) == debounce_id_index(b, 32));
+    CHECK(debounce_id_gen(a) != debounce_id_gen(b));
+
+    /* the stale id leaves the new debouncer alone */
+    CHECK(-1 == bank->disable(a) && -1 == bank->pause(a));
+    press(6, t + 100, 100);
+    run(t + 500);
+    CHECK(2 == ev.count);
+    CHECK(DEB_CLICK == ev.state[0] && DEB_RELEASE == ev.state[1]);
+
+    CHECK(0 == bank->disable(b));
+    printf("  %s: stale ids ok\n", name);
+}
+
+/* a full bank takes a new debouncer once one is disabled, in the freed
+   slot */
+static void test_reuse(const char *name)
+{
+    static DebouncerBank<2> bank;
+    events_t ev;
+    deb_id_t a, b, c;
+
+    memset(&ev, 0, sizeof(ev));
+    CHECK(0 == bank.init(RESOLUTION, CLICK, HOLD));
+
+    a = bank.enable(record, 6, &ev);
+    b = bank.enable(record, 7, &ev);
+    CHECK(0 <= a && 0 <= b);
+    CHECK(-1 == bank.enable(record, 8, &ev));
+
+    CHECK(0 == bank.disable(a));
+    c = bank.enable(record, 8, &ev);
+    CHECK(0 <= c);
+    CHECK(debounce_id_index(a, 2) == debounce_id_index(c, 2));
+    CHECK(debounce_id_gen(a) != debounce_id_gen(c));
+    CHECK(-1 == bank.enable(record, 6, &ev));
+
+    CHECK(0 == bank.disable(b) && 0 == bank.disable(c));
+    printf("  %s: slot reuse ok\n", name);
+}
+
+/* a paused debouncer keeps its id and timing: nothing is reported while
+   paused, and once resumed its double click window works as before */
+template <class Bank>
+static void test_pause(const char *name, Bank *bank)
+{
+    unsigned long t = millis();
+    events_t ev;
+    deb_id_t id;
+
+    memset(&ev, 0, sizeof(ev));
+
+    id = bank->enable(record, 6, &ev, &windowed);
+    CHECK(0 <= id);
+
+    /* a click while paused goes unseen */
+    CHECK(0 == bank->pause(id));
+    CHECK(0 == bank->pause(id));
+    press(6, t + 100, 100);
+    run(t + 600);
+    CHECK(0 == ev.count);
+
+    /* resumed, a single click is held back for the window */
+    CHECK(0 == bank->resume(id));
+    CHECK(0 == bank->resume(id));
+    press(6, t + 700, 100);
+    run(t + 1500);
+    CHECK(1 == ev.count && DEB_CLICK == ev.state[0]);
+    CHECK(t + 800 + 150 <= ev.at[0]);
+
+    /* and a double click still replaces it */
+    press(6, t + 1600, 60);
+    press(6, t + 1720, 60);
+    run(t + 2200);
+    CHECK(3 == ev.count);
+    CHECK(DEB_DOUBLE_CLICK == ev.state[1] && DEB_RELEASE == ev.state[2]);
+
+    CHECK(0 == bank->disable(id));
+    printf("  %s: pause and resume ok\n", name);
+}
+
+/* disables its victim on its first event */
+template <class Bank>
+struct killer_t {
+    Bank *bank;
+    deb_id_t victim;
+    events_t events;
+};
+
+template <class Bank>
+static int killer(deb_id_t id, debouncer_state_t state, void *ctx)
+{
+    killer_t<Bank> *k = (killer_t<Bank> *) ctx;
+
+    record(id, state, &k->events);
+    if (0 <= k->victim) {
+        CHECK(0 == k->bank->disable(k->victim));
+        k->victim = -1;
+    }
+
+    return 0;
+}
+
+/* a handler disabling the debouncer sampled right after its own, in the
+   same tick: that one is skipped and the walk goes on to the rest. lifo
+   tells the bank samples the latest enabled first */
+template <class Bank>
+static void test_disable_next(const char *name, Bank *bank, int lifo)
+{
+    unsigned long t = millis();
+    killer_t<Bank> k;
+    events_t ev_b, ev_c;
+    deb_id_t a, b, c;
+
+    memset(&k, 0, sizeof(k));
+    memset(&ev_b, 0, sizeof(ev_b));
+    memset(&ev_c, 0, sizeof(ev_c));
+
+    /* sampled in the order a, b, c */
+    if (lifo) {
+        c = bank->enable(record, 8, &ev_c);
+        b = bank->enable(record, 7, &ev_b);
+        a = bank->enable(killer<Bank>, 6, &k);
+    }
+    else {
+        a = bank->enable(killer<Bank>, 6, &k);
+        b = bank->enable(record, 7, &ev_b);
+        c = bank->enable(record, 8, &ev_c);
+    }
+    CHECK(0 <= a && 0 <= b && 0 <= c);
+
+    k.bank = bank;
+    k.victim = b;
+
+    press(6, t + 100, 100);
+    press(7, t + 100, 100);
+    press(8, t + 100, 100);
+    run(t + 500);
+
+    CHECK(2 == k.events.count);
+    CHECK(0 == ev_b.count);
+    CHECK(2 == ev_c.count && k.events.at[0] == ev_c.at[0]);
+    CHECK(-1 == bank->disable(b));
+
+    CHECK(0 == bank->disable(a) && 0 == bank->disable(c));
+    printf("  %s: disable from a handler ok\n", name);
+}
+
+/* -- benchmark ------------------------------------------------------------- */
+
+/* sampling n buttons for one tick: a digitalRead() per button as the
+   banks used to, against one read per port in use and a bit test per
+   button. Pins are shared beyond the 20 of the board. Prints host ns
+   per tick */
+static void bench(int n)
+{
+    static debounce_input_t inputs[32];
+    DebouncePorts ports;
+    const int rounds = 200000;
+    volatile int sink = 0;
+    double t0, per_pin, per_port;
+    int r, i, high;
+
+    ports.init();
+    for (i = 0; i < n; ++ i)
+        CHECK(0 == ports.add(i % SIM_PINS, &inputs[i]));
+
+    /* every other pin high, both ways read the same */
+    for (i = 0; i < SIM_PINS; ++ i)
+        sim_digital(i, i & 1);
+
+    t0 = check_ns();
+    for (r = 0; r < rounds; ++ r) {
+        for (high = i = 0; i < n; ++ i)
+            high += (HIGH == digitalRead(inputs[i].pin));
+        sink += high;
+    }
+    per_pin = (check_ns() - t0) / rounds;
+
+    t0 = check_ns();
+    for (r = 0; r < rounds; ++ r) {
+        ports.sample();
+        for (high = i = 0; i < n; ++ i)
+            high += ports.read(&inputs[i]);
+        sink -= high;
+    }
+    per_port = (check_ns() - t0) / rounds;
+
+    CHECK(0 == sink);
+    printf("  %2d buttons: %6.1f ns per tick with digitalRead(), "
+           "%6.1f ns by port (%.1fx)\n", n, per_pin, per_port,
+           per_pin / per_port);
+}
+
+/* one tick of a vertical bank with n of its 32 debouncers enabled, the
+   first one held down. Runs on a timer queue of its own, the other
+   banks are done with. Prints host ns per tick */
+static void bench_vertical(int n)
+{
+    static VerticalDebouncerBank<uint32_t> vbank;
+    static events_t ev;
+    const int rounds = 100000;
+    double t0, per_tick;
+    int r, i;
+
+    CHECK(0 == timers_init());
+    CHECK(0 == vbank.init(RESOLUTION, CLICK, HOLD));
+
+    for (i = 0; i < SIM_PINS; ++ i)
+        sim_digital(i, LOW);
+    for (i = 0; i < n; ++ i)
+        CHECK(0 <= vbank.enable(record, i % SIM_PINS, &ev));
+    sim_digital(0, HIGH);
+
+    t0 = check_ns();
+    for (r = 0; r < rounds; ++ r) {
+        sim_advance(RESOLUTION * 1000UL);
+        timers_check();
+    }
+    per_tick = (check_ns() - t0) / rounds;
+
+    CHECK(0 < ev.count);
+    printf("  vertical bank, %2d of 32 buttons: %5.1f ns per tick\n",
+           n, per_tick);
+}
+
+/* -- main ------------------------------------------------------------------ */
+int main()
+{
+    static DebouncerBank<2> bank;
+    static VerticalDebouncerBank<> vbank;
+    events_t plain, win, vplain, vwin;
+
+    memset(&plain, 0, sizeof(plain));
+    memset(&win, 0, sizeof(win));
+    memset(&vplain, 0, sizeof(vplain));
+    memset(&vwin, 0, sizeof(vwin));
+
+    CHECK(0 == timers_init());
+    CHECK(0 == bank.init(RESOLUTION, CLICK, HOLD));
+    CHECK(0 == vbank.init(RESOLUTION, CLICK, HOLD));
+
+    CHECK(0 <= bank.enable(record, 2, &plain));
+    CHECK(0 <= bank.enable(record, 3, &win, &windowed));
+    CHECK(0 <= vbank.enable(record, 4, &vplain));
+    CHECK(0 <= vbank.enable(record, 5, &vwin, &windowed));
+
+    /* a long press on the plain buttons */
+    press(2, 100, 400);
+    press(4, 100, 400);
+
+    /* click at 900, double click at 2000, long press at 3000 */
+    press(3, 900, 100);
+    press(5, 900, 100);
+    press(3, 2000, 60);
+    press(5, 2000, 60);
+    press(3, 2120, 60);
+    press(5, 2120, 60);
+    press(3, 3000, 600);
+    press(5, 3000, 600);
+
+    run(4000);
+
+    check_plain("bank", &plain);
+    check_plain("vertical bank", &vplain);
+    check_windowed("bank", &win);
+    check_windowed("vertical bank", &vwin);
+
+    /* more banks, run from now on */
+    static DebouncerBank<4> sbank;
+    static VerticalDebouncerBank<> svbank;
+
+    CHECK(0 == sbank.init(RESOLUTION, CLICK, HOLD));
+    CHECK(0 == svbank.init(RESOLUTION, CLICK, HOLD));
+
+    test_ids("bank", &sbank);
+    test_ids("vertical bank", &svbank);
+    test_reuse("bank");
+    test_pause("bank", &sbank);
+    test_pause("vertical bank", &svbank);
+    test_disable_next("bank", &sbank, 1);
+    test_disable_next("vertical bank", &svbank, 0);
+
+    bench(8);
+    bench(16);
+    bench(32);
+    bench_vertical(1);
+    bench_vertical(4);
+    bench_vertical(32);
+
+    return check_status();
+}
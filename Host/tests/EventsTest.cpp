@@ -0,0 +1,187 @@
+/**
+ * @file EventsTest.cpp
+ * @brief Host tests of the deferred event queues (see Events.h)
+ *
+ * Copyright (C) 2013 Marco Pensallorto
+ * < marco DOT pensallorto AT gmail DOT com >
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+**/
+#include <Check.h>
+#include <Sim.h>
+#include <Timers.h>
+#include <Events.h>
+
+/* Events are posted from loop() here, the handlers record the order in
+   which they run. Each test starts over with events_init(). */
+
+const int MAX_RUNS = 64;
+
+typedef struct {
+    long arg[MAX_RUNS];
+    int code[MAX_RUNS];
+    int count;
+} runs_t;
+
+static runs_t runs;
+
+static void record(long arg, int code, void *ctx)
+{
+    if (runs.count < MAX_RUNS) {
+        runs.arg[runs.count] = arg;
+        runs.code[runs.count] = code;
+    }
+
+    ++ runs.count;
+}
+
+/* posts a high priority event the first time it runs */
+static void escalate(long arg, int code, void *ctx)
+{
+    record(arg, code, ctx);
+
+    if (100 == arg)
+        events_post(EVENT_PRIO_HIGH, record, 101, 0, NULL);
+}
+
+/* posts itself again, forever */
+static void repost(long arg, int code, void *ctx)
+{
+    record(arg, code, ctx);
+    events_post(EVENT_PRIO_LOW, repost, arg + 1, 0, NULL);
+}
+
+static void reset()
+{
+    memset(&runs, 0, sizeof(runs));
+    CHECK(0 == events_init());
+}
+
+/* -- tests ----------------------------------------------------------------- */
+
+/* higher priorities first, FIFO within a priority, and an event posted
+   by a handler goes ahead of the lower priorities still waiting */
+static void test_order()
+{
+    const long expected[] = { 1, 2, 10, 100, 101, 11, 200, 201 };
+    unsigned i;
+
+    reset();
+    events_post(EVENT_PRIO_LOW, record, 200, 0, NULL);
+    events_post(EVENT_PRIO_NORMAL, record, 10, 0, NULL);
+    events_post(EVENT_PRIO_LOW, record, 201, 0, NULL);
+    events_post(EVENT_PRIO_HIGH, record, 1, 0, NULL);
+    events_post(EVENT_PRIO_NORMAL, escalate, 100, 0, NULL);
+    events_post(EVENT_PRIO_HIGH, record, 2, 0, NULL);
+    events_post(EVENT_PRIO_NORMAL, record, 11, 0, NULL);
+
+    /* 101, posted by 100, overtakes 11 */
+    CHECK(8 == events_dispatch());
+    CHECK(8 == runs.count);
+    for (i = 0; i < sizeof(expected) / sizeof(expected[0]); ++ i)
+        CHECK(expected[i] == runs.arg[i]);
+
+    CHECK(0 == events_dispatch());
+    printf("  priority order ok\n");
+}
+
+/* the post beyond MAX_EVENTS fails and is counted, the others run */
+static void test_overflow()
+{
+    int i;
+
+    reset();
+    for (i = 0; i < MAX_EVENTS; ++ i)
+        CHECK(0 == events_post(EVENT_PRIO_NORMAL, record, i, 0, NULL));
+
+    CHECK(-1 == events_post(EVENT_PRIO_NORMAL, record, i, 0, NULL));
+    CHECK(1 == events_overflows(EVENT_PRIO_NORMAL));
+    CHECK(0 == events_overflows(EVENT_PRIO_HIGH));
+    CHECK(0 == events_overflows(EVENT_PRIO_LOW));
+
+    /* the dropped one never runs, the ring takes posts again */
+    CHECK(MAX_EVENTS == events_dispatch());
+    CHECK(MAX_EVENTS - 1 == runs.arg[MAX_EVENTS - 1]);
+    CHECK(0 == events_post(EVENT_PRIO_NORMAL, record, 0, 0, NULL));
+    CHECK(1 == events_overflows(EVENT_PRIO_NORMAL));
+
+    printf("  overflow ok\n");
+}
+
+/* a handler posting itself again cannot keep a dispatch going */
+static void test_bound()
+{
+    const int bound = MAX_EVENTS * EVENT_PRIORITIES;
+
+    reset();
+    events_post(EVENT_PRIO_LOW, repost, 0, 0, NULL);
+
+    CHECK(bound == events_dispatch());
+    CHECK(bound == runs.count);
+
+    /* the last one posted is still waiting */
+    CHECK(bound == events_dispatch());
+    CHECK(bound == runs.arg[bound]);
+
+    printf("  %d events per dispatch ok\n", bound);
+}
+
+/* a timer posts an event for its source, once or periodically */
+static void test_timer_post()
+{
+    event_source_t once = { record, NULL, EVENT_PRIO_NORMAL, 0 };
+    event_source_t periodic = { record, NULL, EVENT_PRIO_HIGH, 1 };
+    timer_id_t once_id, periodic_id;
+
+    reset();
+    CHECK(0 == timers_init());
+
+    once_id = timers_schedule(5, events_timer_post, &once);
+    periodic_id = timers_schedule(10, events_timer_post, &periodic);
+    CHECK(0 <= once_id && 0 <= periodic_id);
+
+    /* nothing runs before dispatch */
+    sim_advance(5000);
+    timers_check();
+    CHECK(0 == runs.count);
+
+    CHECK(1 == events_dispatch());
+    CHECK(once_id == runs.arg[0] && 0 == runs.code[0]);
+
+    /* the one-shot timer is gone, the periodic one posts every 10 ms */
+    sim_advance(5000);
+    timers_check();
+    sim_advance(10000);
+    timers_check();
+
+    CHECK(2 == events_dispatch());
+    CHECK(periodic_id == runs.arg[1] && periodic_id == runs.arg[2]);
+    CHECK((ticks_t) ~0UL == timers_timeleft(once_id));
+    CHECK((ticks_t) ~0UL != timers_timeleft(periodic_id));
+
+    printf("  timer post ok\n");
+}
+
+/* -- main ------------------------------------------------------------------ */
+int main()
+{
+    test_order();
+    test_overflow();
+    test_bound();
+    test_timer_post();
+
+    return check_status();
+}
@@ -0,0 +1,140 @@
+/**
+ * @file FiltersTest.cpp
+ * @brief Host tests of the Filters library
+ *
+ * Copyright (C) 2013 Marco Pensallorto
+ * < marco DOT pensallorto AT gmail DOT com >
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+**/
+#include <Check.h>
+#include <MovingAverage.h>
+#include <Thermistor.h>
+
+#include <math.h>
+
+/* The Thermostat sampling path (see sampling_callback in Thermostat.ino)
+   averages raw ADC counts and converts the average, it used to convert
+   every reading and average the temperatures in a ring of doubles. Both
+   are fed the same noisy readings. */
+
+const int N_SAMPLES = 24;
+const long READINGS = 200000;
+
+/* -- readings -------------------------------------------------------------- */
+static unsigned long seed = 1;
+
+/* returns a reading drifting across the -10..90 C range, with +/- 4
+   counts of noise */
+static unsigned int reading(long i)
+{
+    int base = 512 + (int) (300 * sin(i / 5000.0));
+
+    seed = seed * 1103515245UL + 12345;
+    return base + (int) ((seed >> 16) % 9) - 4;
+}
+
+/* returns the temperature for an ADC reading, readTemp() as it was */
+static double celsius(double adc)
+{
+    double sensor = (1023 - adc) * 10000 / adc;
+    return 1 / (log(sensor / 10000) / 3975 + 1 / 298.15) - 273.15;
+}
+
+/* -- main ------------------------------------------------------------------ */
+int main()
+{
+    MovingAverage<N_SAMPLES, unsigned int, unsigned int> average;
+    unsigned int counts[N_SAMPLES];
+    double temps[N_SAMPLES];
+    double worst_exact = 0, worst_table = 0;
+    double t0, old_ns, new_ns;
+    volatile double sink = 0;
+    long i;
+    int j;
+
+    average.init();
+    CHECK(0 == average.average() && ! average.is_full());
+
+    for (i = 0; i < READINGS; ++ i) {
+        unsigned int adc = reading(i);
+        unsigned int sum = 0;
+        double old_avg = 0;
+
+        average.add(adc);
+        counts[i % N_SAMPLES] = adc;
+        temps[i % N_SAMPLES] = celsius(adc);
+
+        if (i < N_SAMPLES - 1) {
+            CHECK(i + 1 == average.count());
+            continue;
+        }
+
+        /* the running sum never drifts from a re-sum */
+        for (j = 0; j < N_SAMPLES; ++ j) {
+            sum += counts[j];
+            old_avg += temps[j];
+        }
+        CHECK(average.is_full());
+        CHECK(sum == average.sum());
+        CHECK(sum / N_SAMPLES == average.average());
+
+        /* the conversion is not linear, the averages differ by the
+           curvature over the noise only */
+        old_avg /= N_SAMPLES;
+        double exact = fabs(celsius((double) sum / N_SAMPLES) - old_avg);
+        double table = fabs(thermistor_centi(thermistor_adc(sum, N_SAMPLES))
+                            / 100.0 - old_avg);
+
+        if (worst_exact < exact)
+            worst_exact = exact;
+        if (worst_table < table)
+            worst_table = table;
+    }
+
+    CHECK(worst_exact < 0.01);
+    CHECK(worst_table <= 0.05);
+    printf("  worst difference from the float average: %.4f C converting "
+           "the average, %.4f C through the table\n",
+           worst_exact, worst_table);
+
+    /* the old path: a reading converted, 24 doubles summed */
+    seed = 1;
+    t0 = check_ns();
+    for (i = 0; i < READINGS; ++ i) {
+        double sum = 0;
+
+        temps[i % N_SAMPLES] = celsius(reading(i));
+        for (j = 0; j < N_SAMPLES; ++ j)
+            sum += temps[j];
+        sink += sum / N_SAMPLES;
+    }
+    old_ns = (check_ns() - t0) / READINGS;
+
+    seed = 1;
+    average.init();
+    t0 = check_ns();
+    for (i = 0; i < READINGS; ++ i) {
+        average.add(reading(i));
+        sink += thermistor_centi(thermistor_adc(average.sum(), N_SAMPLES));
+    }
+    new_ns = (check_ns() - t0) / READINGS;
+
+    printf("  host ns per sample: %.1f float ring, %.1f moving average "
+           "(%.1fx)\n", old_ns, new_ns, old_ns / new_ns);
+
+    return check_status();
+}
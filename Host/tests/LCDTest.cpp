@@ -0,0 +1,342 @@
+/**
+ * @file LCDTest.cpp
+ * @brief Host tests of the SerialLCD driver
+ *
+ * Copyright (C) 2013 Marco Pensallorto
+ * < marco DOT pensallorto AT gmail DOT com >
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+**/
+#include <Check.h>
+#include <Sim.h>
+#include <SimLCD.h>
+#include <SerialLCD.h>
+
+/* Two drivers, one drawing straight to its display and one through the
+   shadow framebuffer (see SerialLCD::buffer), draw the Thermostat
+   screen. Both displays must end up the same, bytes on the wire are
+   compared. */
+
+const int UPDATES = 240;
+
+/* tx pins of the two displays */
+const uint8_t direct_tx = 3;
+const uint8_t buffered_tx = 5;
+
+/* -- screen ---------------------------------------------------------------- */
+
+/* draws update i of the Thermostat screen, see update_display() in
+   Thermostat.ino */
+static void draw(SerialLCD *lcd, int i)
+{
+    long curr = 2150 + (i * 7) % 60;     /* C/100, drifting */
+    long goal = 2500 + (i / 80) * 50;    /* a setpoint step now and then */
+    int minutes = i / 120;
+    char clock[6];
+
+    if (0 == i) {
+        lcd->setCursor(5, 0);
+        lcd->print('C');
+        lcd->setCursor(5, 1);
+        lcd->print('C');
+    }
+
+    lcd->setCursor(0, 0);
+    lcd->printFixed((curr + 5) / 10, 1);
+
+    lcd->setCursor(0, 1);
+    lcd->printFixed((goal + 5) / 10, 1);
+
+    /* hh:mm, the separator blinks */
+    clock[0] = '0' + minutes / 600;
+    clock[1] = '0' + minutes / 60 % 10;
+    clock[2] = (i & 1) ? ':' : ' ';
+    clock[3] = '0' + minutes % 60 / 10;
+    clock[4] = '0' + minutes % 10;
+    clock[5] = '\0';
+
+    lcd->setCursor(11, 1);
+    lcd->print(clock);
+}
+
+/* -- numbers --------------------------------------------------------------- */
+
+/* SLCDprintFloat, as the Thermostat sketch had it before printFixed */
+static void legacy_print_float(SerialLCD *lcd, double number, uint8_t digits)
+{
+    if (number < 0.0) {
+        lcd->print('-');
+        number = -number;
+    }
+
+    double rounding = 0.5;
+    for (uint8_t i=0; i<digits; ++i) {
+        rounding /= 10.0;
+    }
+
+    number += rounding;
+
+    unsigned long int_part = (unsigned long)number;
+    float remainder = number - (float)int_part;
+    lcd->print(int_part , DEC);
+
+    if (digits > 0) {
+        lcd->print(".");
+    }
+
+    while (digits-- > 0) {
+        remainder *= 10.0;
+        float toPrint = float(remainder);
+        lcd->print(toPrint , DEC);
+        remainder -= toPrint;
+    }
+}
+
+/* see print_temp() in Thermostat.ino */
+static void print_temp(SerialLCD *lcd, int t)
+{
+    lcd->printFixed(((long) t + (t < 0 ? -5 : 5)) / 10, 1);
+}
+
+/* what printing draws at the left of the top row of lcd, on sim */
+typedef void print_fn_t(SerialLCD *lcd, double number, uint8_t digits);
+
+static const char *shown(SerialLCD *lcd, sim_lcd_t *sim, print_fn_t *print,
+                         double number, uint8_t digits, char *buf)
+{
+    char *p;
+
+    lcd->setCursor(0, 0);
+    lcd->print("                ");
+    lcd->setCursor(0, 0);
+    print(lcd, number, digits);
+    lcd->drain();
+
+    strcpy(buf, sim->rows[0]);
+    for (p = buf + strlen(buf); buf < p && ' ' == p[-1]; -- p)
+        ;
+    *p = '\0';
+
+    return buf;
+}
+
+static void print_float(SerialLCD *lcd, double number, uint8_t digits)
+{ lcd->printFloat(number, digits); }
+
+/* temperatures, as the sketch shows them: number is in centi-degrees */
+static void print_centi(SerialLCD *lcd, double number, uint8_t digits)
+{ print_temp(lcd, (int) number); }
+
+static void legacy_centi(SerialLCD *lcd, double number, uint8_t digits)
+{ legacy_print_float(lcd, number / 100.0, digits); }
+
+typedef struct {
+    double number;
+    uint8_t digits;
+    const char *text;
+    const char *legacy;
+} number_t;
+
+/* printFloat against the old routine. They differ where the old one was
+   off: it printed "-0.0" for negative numbers rounding to zero, added its
+   rounding to the binary number before scaling (9.995 is 9.99499..., and
+   9.995 + 0.005 is 10 in a double), and truncated all decimals after the
+   first to zero. The sketch printed a single decimal */
+static const number_t numbers[] = {
+    {       0.0, 1, "0.0",    "0.0" },
+    {       0.0, 0, "0",      "0" },
+    {      21.5, 1, "21.5",   "21.5" },
+    {     -21.5, 1, "-21.5",  "-21.5" },
+    {     21.45, 1, "21.5",   "21.5" },
+    {    -21.45, 1, "-21.5",  "-21.5" },
+    {      9.95, 1, "10.0",   "10.0" },
+    {     -9.95, 1, "-10.0",  "-10.0" },
+    {     99.96, 1, "100.0",  "100.0" },
+    {    -40.25, 1, "-40.3",  "-40.3" },
+    {     123.45, 0, "123",   "123" },
+    {      0.05, 1, "0.1",    "0.1" },
+    {     -0.05, 1, "-0.1",   "-0.1" },
+    {     -0.04, 1, "0.0",    "-0.0" },
+    {     1.999, 2, "2.00",   "2.00" },
+    {     9.995, 2, "9.99",   "10.00" },
+    {   3.14159, 4, "3.1416", "3.1000" },
+};
+
+/* each number of the table, and every temperature the sketch shows from
+   -40 to 125 C, against the old routine */
+static void test_numbers(SerialLCD *lcd, sim_lcd_t *sim)
+{
+    char buf[SIM_LCD_COLS + 1], legacy[SIM_LCD_COLS + 1];
+    unsigned i;
+    int t, differ = 0, minus_zero = 0;
+
+    for (i = 0; i < sizeof(numbers) / sizeof(numbers[0]); ++ i) {
+        const number_t *n = &numbers[i];
+
+        CHECK(0 == strcmp(n->text, shown(lcd, sim, print_float, n->number,
+                                         n->digits, buf)));
+        CHECK(0 == strcmp(n->legacy, shown(lcd, sim, legacy_print_float,
+                                           n->number, n->digits, buf)));
+    }
+
+    for (t = -4000; t <= 12500; ++ t) {
+        shown(lcd, sim, print_centi, t, 1, buf);
+        shown(lcd, sim, legacy_centi, t, 1, legacy);
+
+        if (0 == strcmp(legacy, "-0.0") && 0 == strcmp(buf, "0.0"))
+            ++ minus_zero;
+        else if (strcmp(legacy, buf))
+            ++ differ;
+    }
+
+    /* -0.04 to -0.01 C only */
+    CHECK(0 == differ && 4 == minus_zero);
+    printf("  %d temperatures: %d shown differently, %d as -0.0 before\n",
+           12500 + 4000 + 1, differ, minus_zero);
+}
+
+/* ns per call, queueing only: the display is drained out of the timing.
+   Host FPUs flatter the old routine, AVRs have none */
+static void bench_numbers(SerialLCD *lcd, sim_lcd_t *sim)
+{
+    const int ROUNDS = 20000;
+    print_fn_t *fns[] = { legacy_centi, print_centi };
+    const char *names[] = { "SLCDprintFloat()", "printFixed()" };
+    double ns[2], bytes[2];
+    int f, t;
+
+    for (f = 0; f < 2; ++ f) {
+        unsigned long sent = sim->bytes;
+        double total = 0, t0;
+
+        for (t = 0; t < ROUNDS; ++ t) {
+            lcd->setCursor(0, 0);
+            lcd->drain();
+
+            t0 = check_ns();
+            fns[f](lcd, -4000 + t % 16501, 1);
+            total += check_ns() - t0;
+
+            lcd->drain();
+        }
+
+        ns[f] = total / ROUNDS;
+        bytes[f] = (double) (sim->bytes - sent) / ROUNDS;
+    }
+
+    for (f = 0; f < 2; ++ f)
+        printf("  temperature with %-16s: %6.1f ns, %4.1f bytes per call\n",
+               names[f], ns[f], bytes[f]);
+    CHECK(bytes[1] <= bytes[0]);
+}
+
+/* -- main ------------------------------------------------------------------ */
+int main()
+{
+    static SerialLCD direct(2, direct_tx), buffered(4, buffered_tx);
+    sim_lcd_t direct_lcd, buffered_lcd;
+    unsigned long direct_bytes, buffered_bytes;
+    int i, same = 1;
+
+    sim_lcd_init(&direct_lcd, direct_tx);
+    sim_lcd_init(&buffered_lcd, buffered_tx);
+
+    CHECK(0 == direct.begin());
+    CHECK(0 == buffered.begin());
+    buffered.buffer();
+
+    direct.drain();
+    buffered.drain();
+    direct_bytes = direct_lcd.bytes;
+    buffered_bytes = buffered_lcd.bytes;
+
+    /* chars and frames from now on */
+    direct_lcd.chars = direct_lcd.frames = 0;
+    buffered_lcd.chars = buffered_lcd.frames = 0;
+
+    for (i = 0; i < UPDATES; ++ i) {
+        draw(&direct, i);
+        direct.drain();
+
+        /* a full redraw fits the queue, the first one included */
+        draw(&buffered, i);
+        CHECK(0 == buffered.refresh());
+        buffered.drain();
+
+        same &= (0 == memcmp(direct_lcd.rows, buffered_lcd.rows,
+                             sizeof(direct_lcd.rows)));
+    }
+
+    direct_bytes = direct_lcd.bytes - direct_bytes;
+    buffered_bytes = buffered_lcd.bytes - buffered_bytes;
+
+    CHECK(same);
+    CHECK(0 == strcmp(buffered_lcd.rows[1], "26.0 C     00:01"));
+    CHECK(0 == direct.timeouts() && 0 == buffered.timeouts());
+
+    /* framebuffer: only what changed is sent */
+    CHECK(buffered_bytes < direct_bytes / 2);
+    printf("  bytes per update: %.1f drawn directly, %.1f through the "
+           "framebuffer\n", (double) direct_bytes / UPDATES,
+           (double) buffered_bytes / UPDATES);
+
+    /* batching: one header per run of chars, instead of one per char */
+    unsigned long unbatched = direct_bytes - direct_lcd.frames +
+        direct_lcd.chars;
+    CHECK(direct_bytes < unbatched);
+    printf("  bytes per direct update: %.1f batched, %.1f with a header "
+           "per char\n", (double) direct_bytes / UPDATES,
+           (double) unbatched / UPDATES);
+
+    unbatched = buffered_bytes - buffered_lcd.frames + buffered_lcd.chars;
+    CHECK(buffered_bytes < unbatched);
+    printf("  bytes per buffered update: %.1f batched, %.1f with a "
+           "header per char\n", (double) buffered_bytes / UPDATES,
+           (double) unbatched / UPDATES);
+
+    /* a refresh with the queue full neither blocks nor loses cells: it
+       stops, the next one resumes */
+    unsigned long sent = sim_serial_sent(buffered_tx);
+    unsigned int overflows = buffered.overflows();
+    int refreshes = 0;
+
+    for (i = 0; i < SLCD_TX_QUEUE_SIZE / 2; ++ i)
+        buffered.backlight();
+
+    buffered.setCursor(0, 0);
+    buffered.print("0123456789ABCDEF");
+    buffered.setCursor(0, 1);
+    buffered.print("fedcba9876543210");
+
+    CHECK(1 == buffered.refresh());
+    CHECK(sent == sim_serial_sent(buffered_tx));
+    CHECK(overflows < buffered.overflows());
+
+    do {
+        buffered.drain();
+        ++ refreshes;
+    } while (buffered.refresh() && refreshes < 10);
+
+    buffered.drain();
+    CHECK(0 == strcmp(buffered_lcd.rows[0], "0123456789ABCDEF"));
+    CHECK(0 == strcmp(buffered_lcd.rows[1], "fedcba9876543210"));
+    printf("  queue full: redrawn in %d more refreshes\n", refreshes);
+
+    test_numbers(&direct, &direct_lcd);
+    bench_numbers(&direct, &direct_lcd);
+
+    return check_status();
+}
@@ -0,0 +1,214 @@
+/**
+ * @file MicrotimersTest.cpp
+ * @brief Host tests of the Microtimers library, on the mock micros()
+ *
+ * Copyright (C) 2013 Marco Pensallorto
+ * < marco DOT pensallorto AT gmail DOT com >
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+**/
+#include <Check.h>
+#include <Sim.h>
+#include <Microtimers.h>
+
+/* Microtimers runs the heap engine on MicrosClock, that is on the mock
+   micros() of the harness: each reading costs SIM_CLOCK_READ_US of
+   virtual time, as a real one costs a few cycles. loop() is a busy
+   loop here, LOOP_US of other work between two utimers_check(). */
+
+const unsigned long LOOP_US = 3;
+const unsigned long RUN_US = 50000;
+
+/* lateness of a fire in a busy loop: the pass it falls in, the clock
+   readings of check() and those of the timers firing before it */
+const unsigned long LATE_US = LOOP_US + (3 + 4) * SIM_CLOCK_READ_US;
+
+/* -- handlers -------------------------------------------------------------- */
+const int MAX_FIRES = RUN_US / 20 + 1;
+
+typedef struct {
+    uticks_t period;
+    uticks_t first; /* ideal deadline of the first fire */
+    utimer_id_t id;
+
+    uticks_t at[MAX_FIRES];
+    int count;
+} periodic_t;
+
+static int record(utimer_id_t id, uticks_t now, void *ctx)
+{
+    periodic_t *p = (periodic_t *) ctx;
+
+    if (p->count < MAX_FIRES)
+        p->at[p->count] = now;
+
+    ++ p->count;
+    return 1;
+}
+
+/* schedules p, noting its first deadline: schedule() reads the clock
+   once, and adds the period to what it read */
+static void schedule(periodic_t *p, uticks_t period)
+{
+    memset(p, 0, sizeof(*p));
+    p->period = period;
+    p->first = (uticks_t) (sim_now() + SIM_CLOCK_READ_US) + period;
+    p->id = utimers_schedule(period, record, p);
+    CHECK(0 <= p->id);
+}
+
+/* runs the busy loop until us, stalling once for stall_us at stall_at */
+static void run(unsigned long us, unsigned long stall_at,
+                unsigned long stall_us)
+{
+    while (sim_now() < us) {
+        utimers_check();
+        sim_advance(LOOP_US);
+
+        if (0 < stall_us && stall_at <= sim_now()) {
+            sim_advance(stall_us);
+            stall_us = 0;
+        }
+    }
+}
+
+/* -- tests ----------------------------------------------------------------- */
+
+/* periodic timers under 100 us: every fire lands within LATE_US of its
+   ideal deadline first + n * period, never before, and its lateness
+   does not add up. A timer rescheduled from the time it fired would
+   have drifted by the sum of its lateness instead */
+static void test_grid()
+{
+    const uticks_t periods[] = { 20, 37, 64, 99 };
+    const int N = sizeof(periods) / sizeof(periods[0]);
+    static periodic_t timers[N];
+    unsigned long start;
+    int i, n;
+
+    CHECK(0 == utimers_init(0, TIMER_CATCHUP_BURST));
+    for (i = 0; i < N; ++ i)
+        schedule(&timers[i], periods[i]);
+
+    start = sim_now();
+    run(start + RUN_US, 0, 0);
+
+    for (i = 0; i < N; ++ i) {
+        periodic_t *p = &timers[i];
+        uticks_t worst = 0, drift = 0, end;
+        int early = 0, late = 0;
+
+        for (n = 0; n < p->count && n < MAX_FIRES; ++ n) {
+            uticks_t deadline = p->first + n * p->period;
+            uticks_t lateness = p->at[n] - deadline;
+
+            early |= (p->at[n] < deadline);
+            late |= (LATE_US < lateness);
+            if (worst < lateness)
+                worst = lateness;
+            drift += lateness;
+        }
+
+        /* one fire per period run, to the last one due */
+        end = (uticks_t) sim_now() - LATE_US;
+        CHECK(p->count <= MAX_FIRES);
+        CHECK((int) ((end - p->first) / p->period) + 1 <= p->count);
+        CHECK(p->count <= (int) ((sim_now() - p->first) / p->period) + 1);
+
+        CHECK(! early && ! late);
+        CHECK(worst == utimers_jitter(p->id));
+
+        printf("  %2lu us period: %4d fires, %lu us worst lateness, "
+               "%lu us of drift avoided\n", p->period, p->count, worst,
+               drift);
+    }
+
+    for (i = 0; i < N; ++ i)
+        CHECK(0 == utimers_cancel(timers[i].id));
+}
+
+/* the loop stalls for 25 and a half periods of a 40 us timer: what
+   happens to the periods missed depends on the catch-up policy */
+static void test_stall(timer_catchup_t catchup, const char *name)
+{
+    const uticks_t period = 40;
+    const unsigned long stall = 1020;
+    static periodic_t p;
+    unsigned long start, resumed;
+    int n, after, off_grid = 0, on_old_grid = 1, bursts = 0;
+
+    CHECK(0 == utimers_init(0, catchup));
+    schedule(&p, period);
+
+    start = sim_now();
+    run(start + RUN_US, start + RUN_US / 2, stall);
+    resumed = start + RUN_US / 2 + stall;
+
+    /* first fire after the stall */
+    for (after = 0; after < p.count && p.at[after] < resumed; ++ after)
+        ;
+    CHECK(0 < after && after < p.count && p.count <= MAX_FIRES);
+
+    /* the overdue fire runs as the loop resumes, off any grid */
+    for (n = after + 1; n < p.count; ++ n) {
+        uticks_t grid = (p.at[n] - p.first) % period;
+        uticks_t phase = (p.at[n] - p.at[after]) % period;
+
+        /* COALESCE starts a new grid from the overdue fire */
+        if (TIMER_CATCHUP_COALESCE == catchup) {
+            on_old_grid &= (grid <= LATE_US);
+            grid = phase;
+        }
+
+        /* BURST fires each missed period late, never early */
+        if (TIMER_CATCHUP_BURST == catchup)
+            off_grid |= (p.at[n] - p.first < n * period);
+        else
+            off_grid |= (LATE_US < grid);
+
+        bursts += (after + 1 < n && p.at[n] - p.at[n - 1] < period / 2);
+    }
+
+    CHECK(! off_grid);
+
+    /* BURST fires every period missed, back to back, SKIP and COALESCE
+       drop them */
+    if (TIMER_CATCHUP_BURST == catchup) {
+        CHECK((int) (stall / period) - 2 <= bursts);
+        CHECK(p.at[p.count - 1] - (p.first + (p.count - 1) * period)
+              <= LATE_US);
+    }
+    else {
+        CHECK(0 == bursts);
+        CHECK(on_old_grid == (TIMER_CATCHUP_SKIP == catchup));
+        CHECK(p.count <= (int) ((sim_now() - p.first - stall) / period) + 2);
+    }
+
+    CHECK(0 == utimers_cancel(p.id));
+    printf("  %-8s: %d fires, %d after a %lu us stall, %d back to back\n",
+           name, p.count, p.count - after, stall, bursts);
+}
+
+/* -- main ------------------------------------------------------------------ */
+int main()
+{
+    test_grid();
+    test_stall(TIMER_CATCHUP_BURST, "burst");
+    test_stall(TIMER_CATCHUP_SKIP, "skip");
+    test_stall(TIMER_CATCHUP_COALESCE, "coalesce");
+
+    return check_status();
+}
@@ -0,0 +1,103 @@
+/**
+ * @file ThermistorTest.cpp
+ * @brief Host tests of the Thermistor library
+ *
+ * Copyright (C) 2013 Marco Pensallorto
+ * < marco DOT pensallorto AT gmail DOT com >
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+**/
+#include <Check.h>
+#include <Thermistor.h>
+
+/* The table is swept every 1/16th of an ADC count, against the B
+   formula it was generated from (see thermistor_table.py) */
+
+const int STEPS = 1 << THERMISTOR_FRAC_BITS;
+
+/* returns the temperature for a (fractional) ADC reading, B formula */
+static double celsius(double adc)
+{
+    double r = (1023 - adc) * 10000.0 / adc;
+    return 1 / (log(r / 10000.0) / 3975 + 1 / 298.15) - 273.15;
+}
+
+/* returns the worst error (C) from lo to hi C */
+static double sweep(double lo, double hi)
+{
+    double worst = 0;
+    unsigned int adc;
+
+    for (adc = 1; adc < 1023U * STEPS; ++ adc) {
+        double expected = celsius((double) adc / STEPS);
+        double error = fabs(thermistor_centi(adc) / 100.0 - expected);
+
+        if (expected < lo || hi < expected)
+            continue;
+
+        if (worst < error)
+            worst = error;
+    }
+
+    return worst;
+}
+
+/* -- main ------------------------------------------------------------------ */
+int main()
+{
+    const int rounds = 50;
+    volatile double sink_f = 0;
+    volatile long sink_i = 0;
+    double t0, table_ns, log_ns;
+    unsigned int adc;
+    int r;
+
+    double worst = sweep(-10, 90);
+    CHECK(worst <= 0.05);
+    printf("  worst error %.3f C from -10 to 90 C, %.3f C from -40 to "
+           "125 C\n", worst, sweep(-40, 125));
+
+    /* monotonic, as the control path expects */
+    for (adc = 1; adc < 1023U * STEPS; ++ adc)
+        CHECK(thermistor_centi(adc - 1) <= thermistor_centi(adc));
+
+    /* averages of whole counts land on the same figures */
+    CHECK(thermistor_centi(thermistor_adc(24UL * 512, 24)) ==
+          thermistor_centi(512 * STEPS));
+
+    t0 = check_ns();
+    for (r = 0; r < rounds; ++ r) {
+        for (adc = STEPS; adc < 1023U * STEPS; ++ adc)
+            sink_i += thermistor_centi(adc);
+    }
+    table_ns = (check_ns() - t0) / rounds / (1022 * STEPS);
+
+    /* the conversion it replaces, single precision like avr-gcc doubles */
+    t0 = check_ns();
+    for (r = 0; r < rounds; ++ r) {
+        for (adc = STEPS; adc < 1023U * STEPS; ++ adc) {
+            float sensor = (float) (1023 * STEPS - adc) * 10000 / adc;
+            sink_f += 1 / (logf(sensor / 10000) / 3975 + 1 / 298.15f) -
+                273.15f;
+        }
+    }
+    log_ns = (check_ns() - t0) / rounds / (1022 * STEPS);
+
+    printf("  host ns per conversion: %.1f table, %.1f log() (%.1fx)\n",
+           table_ns, log_ns, log_ns / table_ns);
+
+    return check_status();
+}
@@ -0,0 +1,93 @@
+/**
+ * @file ThermostatIdleTest.cpp
+ * @brief Loop passes of the Thermostat sketch, with and without idle sleep
+ *
+ * Copyright (C) 2013 Marco Pensallorto
+ * < marco DOT pensallorto AT gmail DOT com >
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+**/
+#include <Check.h>
+#include <Sim.h>
+#include <SimLCD.h>
+#include <SimRoom.h>
+#include <Timers.h>
+
+/* The sketch runs for a while spinning loop(), then as long again
+   sleeping until the next timer in between passes, as timers_idle()
+   does on AVR (it does nothing on the host). Passes are counted: those
+   that found no timer due were spent for nothing. */
+
+const unsigned long PHASE = 60; /* s */
+
+/* sketch entry points, see Thermostat.ino */
+void setup();
+void loop();
+
+/* pins, see Thermostat.ino */
+static const uint8_t ai_thermistor = 0;
+static const uint8_t do_actuate = 4;
+static const uint8_t slcd_tx_pin = 12;
+
+/* -- main ------------------------------------------------------------------ */
+int main()
+{
+    unsigned long busy = 0, idle = 0;
+    sim_room_t room;
+    sim_lcd_t lcd;
+    sim_time_t end;
+
+    sim_room_init(&room, 15, do_actuate);
+    sim_lcd_init(&lcd, slcd_tx_pin);
+    sim_analog_source(ai_thermistor, sim_room_adc, &room);
+
+    setup();
+
+    /* spinning, each pass costs whatever its millis() reads do */
+    end = sim_now() + PHASE * 1000000ULL;
+    while (sim_now() < end) {
+        loop();
+        ++ busy;
+    }
+
+    /* sleeping until the next deadline */
+    end = sim_now() + PHASE * 1000000ULL;
+    while (sim_now() < end) {
+        ticks_t left;
+
+        loop();
+        ++ idle;
+
+        left = timers_next_deadline();
+        CHECK((ticks_t) -1 != left);
+        sim_idle((left < 1000) ? left * 1000ULL : 1000000ULL);
+    }
+
+    /* timers still fire, the display still updates */
+    CHECK(0 != lcd.bytes);
+    CHECK(0 != strstr(lcd.rows[0], " C"));
+    CHECK(100 * idle < busy);
+
+    /* debouncers every 10 ms, sampling every 125 ms and the rest: the LCD
+       poll timer only runs while there is something to send */
+    CHECK(idle < 200 * PHASE);
+
+    printf("  loop passes per second: %lu spinning, %lu sleeping "
+           "(%.0fx fewer)\n", busy / PHASE,
+           idle / PHASE, (double) busy / idle);
+
+    return check_status();
+}
@@ -0,0 +1,577 @@
+/**
+ * @file TimersTest.cpp
+ * @brief Host tests of the timer engines (see TimerCore.h)
+ *
+ * Copyright (C) 2013 Marco Pensallorto
+ * < marco DOT pensallorto AT gmail DOT com >
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+**/
+#include <Check.h>
+#include <Sim.h>
+#include <TimerHeap.h>
+#include <TimerWheel.h>
+
+/* Timer engines run on a fake tick source here, so that the clock can
+   be set right before the wrap point, and stepped one tick at a time. */
+
+/* -- fake clocks ----------------------------------------------------------- */
+template <typename T>
+struct FakeClock {
+    typedef T ticks_t;
+    static T t;
+    static T now() { return t; }
+};
+
+template <typename T> T FakeClock<T>::t;
+
+typedef FakeClock<unsigned long> Clock32;
+typedef FakeClock<unsigned short> Clock16;
+
+/* -- handlers -------------------------------------------------------------- */
+const int MAX_FIRES = 300;
+
+typedef struct {
+    unsigned long at[MAX_FIRES];
+    int tag[MAX_FIRES];
+    int count;
+} fires_t;
+
+static fires_t fires;
+
+/* records a fire, ctx points to the tag of the timer */
+template <typename T>
+static int record(timer_core_id_t id, T now, void *ctx)
+{
+    if (fires.count < MAX_FIRES) {
+        fires.at[fires.count] = now;
+        fires.tag[fires.count] = *(int *) ctx;
+    }
+
+    ++ fires.count;
+    return 0 <= *(int *) ctx; /* negative tags are one-shot */
+}
+
+/* -- wrap ------------------------------------------------------------------ */
+
+/* a one-shot and a periodic timer both run across the wrap point of a
+   32 bits clock, checked every tick */
+template <class Engine>
+static void test_wrap_32(const char *name)
+{
+    static Engine engine;
+    const unsigned long start = 0xFFFFFFFFUL - 50;
+    int periodic = 1, oneshot = -1;
+    int i;
+
+    Clock32::t = start;
+    memset(&fires, 0, sizeof(fires));
+
+    engine.init(5, TIMER_CATCHUP_BURST);
+    timer_core_id_t id = engine.schedule(100, record<unsigned long>,
+                                         &oneshot);
+    engine.schedule(30, record<unsigned long>, &periodic);
+
+    CHECK(100 == engine.timeleft(id));
+    CHECK(30 == engine.next_deadline());
+
+    for (i = 0; i <= 130; ++ i, ++ Clock32::t)
+        engine.check();
+
+    /* periodic at 30, 60, 90 (after the wrap), one-shot at 100, then
+       periodic again at 120 */
+    CHECK(5 == fires.count);
+    CHECK(start + 30 == fires.at[0] && 1 == fires.tag[0]);
+    CHECK(start + 60 == fires.at[1] && 1 == fires.tag[1]);
+    CHECK(start + 90 == fires.at[2] && 1 == fires.tag[2]);
+    CHECK(start + 100 == fires.at[3] && -1 == fires.tag[3]);
+    CHECK(start + 120 == fires.at[4] && 1 == fires.tag[4]);
+
+    /* the one-shot is gone, its id is rejected */
+    CHECK((unsigned long) ~0UL == engine.timeleft(id));
+
+    printf("  %s: 32 bits wrap ok\n", name);
+}
+
+/* a periodic timer on a 16 bits clock goes round the clock several
+   times, it must keep its period and never be late */
+template <class Engine>
+static void test_wrap_16(const char *name)
+{
+    static Engine engine;
+    const unsigned short period = 1000;
+    const long ticks = 300000L; /* about 4.6 wraps */
+    int periodic = 1;
+    unsigned short last;
+    long i;
+    int late = 0;
+
+    Clock16::t = 0xFFFF - 10;
+    memset(&fires, 0, sizeof(fires));
+
+    engine.init(5, TIMER_CATCHUP_BURST);
+    timer_core_id_t id = engine.schedule(period, record<unsigned short>,
+                                         &periodic);
+
+    last = Clock16::t;
+    for (i = 0; i <= ticks; ++ i, ++ Clock16::t) {
+        int count = fires.count;
+
+        engine.check();
+        if (count != fires.count) {
+            late |= ((unsigned short) (Clock16::t - last) != period);
+            last = Clock16::t;
+        }
+    }
+
+    CHECK(ticks / period == fires.count);
+    CHECK(! late);
+    CHECK(0 == engine.jitter(id));
+
+    printf("  %s: 16 bits, %d fires over %ld ticks, on time\n",
+           name, fires.count, ticks);
+}
+
+/* -- dispatch ------------------------------------------------------------- */
+
+/* periodic timers at 10 and 12, a one-shot at 30 and the clock jumping
+   to 40: the periodic timers are due again after firing, yet the
+   one-shot must fire in the first pass, and nothing is overrun while
+   the pass stays within max_timeouts */
+template <class Engine>
+static void test_burst(const char *name)
+{
+    static Engine engine;
+    int fast = 1, slow = 2, oneshot = -1;
+    timer_overrun_t overrun;
+
+    Clock32::t = 0;
+    memset(&fires, 0, sizeof(fires));
+
+    engine.init(5, TIMER_CATCHUP_BURST);
+    engine.schedule(10, record<unsigned long>, &fast);
+    engine.schedule(12, record<unsigned long>, &slow);
+    engine.schedule(30, record<unsigned long>, &oneshot);
+
+    Clock32::t = 40;
+    engine.check();
+    engine.overrun(&overrun);
+
+    CHECK(3 == fires.count);
+    CHECK(1 == fires.tag[0] && 2 == fires.tag[1] && -1 == fires.tag[2]);
+    CHECK(0 == overrun.overruns && 0 == overrun.deferred);
+
+    /* the periodic timers catch up one period per pass */
+    CHECK(0 == engine.next_deadline());
+    ++ Clock32::t;
+    engine.check();
+    CHECK(5 == fires.count);
+
+    /* a pass that does run out of max_timeouts still counts */
+    Clock32::t = 0;
+    engine.init(2, TIMER_CATCHUP_BURST);
+    engine.schedule(10, record<unsigned long>, &fast);
+    engine.schedule(12, record<unsigned long>, &slow);
+    engine.schedule(30, record<unsigned long>, &oneshot);
+
+    Clock32::t = 40;
+    engine.check();
+    engine.overrun(&overrun);
+
+    CHECK(1 == overrun.overruns && 1 == overrun.deferred);
+
+    printf("  %s: burst ok\n", name);
+}
+
+/* max_timeouts 0 puts no bound on a pass: everything due fires at once */
+template <class Engine>
+static void test_unlimited(const char *name)
+{
+    static Engine engine;
+    timer_overrun_t overrun;
+    int oneshot = -1, i;
+
+    Clock32::t = 0;
+    memset(&fires, 0, sizeof(fires));
+
+    engine.init(0, TIMER_CATCHUP_BURST);
+    for (i = 0; i < 20; ++ i)
+        engine.schedule(i % 5, record<unsigned long>, &oneshot);
+
+    Clock32::t = 10;
+    engine.check();
+    engine.overrun(&overrun);
+
+    CHECK(20 == fires.count);
+    CHECK(0 == overrun.overruns && 0 == overrun.deferred);
+    CHECK((unsigned long) ~0UL == engine.next_deadline());
+
+    printf("  %s: unlimited pass ok\n", name);
+}
+
+/* a delay of 0 is due at once: the next check() fires it, even on the
+   same tick as the last one, and a delay of 1 on the tick after */
+template <class Engine>
+static void test_zero(const char *name)
+{
+    static Engine engine;
+    int now = -1, next = -2;
+
+    Clock32::t = 100;
+    memset(&fires, 0, sizeof(fires));
+
+    engine.init(5, TIMER_CATCHUP_BURST);
+    engine.check();
+
+    engine.schedule(1, record<unsigned long>, &next);
+    engine.schedule(0, record<unsigned long>, &now);
+    CHECK(0 == engine.next_deadline());
+
+    engine.check();
+    CHECK(1 == fires.count);
+    CHECK(100 == fires.at[0] && -1 == fires.tag[0]);
+
+    ++ Clock32::t;
+    engine.check();
+    CHECK(2 == fires.count);
+    CHECK(101 == fires.at[1] && -2 == fires.tag[1]);
+
+    /* and after a gap, with the wheel left behind */
+    Clock32::t = 5000;
+    engine.schedule(0, record<unsigned long>, &now);
+    engine.check();
+    CHECK(3 == fires.count && 5000 == fires.at[2]);
+
+    printf("  %s: delay 0 ok\n", name);
+}
+
+/* timers on every level of the wheel, and a check() after a long gap:
+   due timers fire in deadline order, the others on time afterwards */
+template <class Engine>
+static void test_gap(const char *name)
+{
+    static Engine engine;
+    int periodic = 1, a = -1, b = -2, c = -3, d = -4;
+    unsigned long i;
+    double t0, gap_ns;
+    int late = 0, count;
+
+    Clock32::t = 0;
+    memset(&fires, 0, sizeof(fires));
+
+    engine.init(10, TIMER_CATCHUP_SKIP);
+    engine.schedule(90000, record<unsigned long>, &c);
+    engine.schedule(50, record<unsigned long>, &a);
+    engine.schedule(3000, record<unsigned long>, &periodic);
+    engine.schedule(7000, record<unsigned long>, &b);
+    engine.schedule(1199000, record<unsigned long>, &d);
+
+    Clock32::t = 1000000;
+    t0 = check_ns();
+    engine.check();
+    gap_ns = check_ns() - t0;
+
+    CHECK(4 == fires.count);
+    CHECK(-1 == fires.tag[0] && 1 == fires.tag[1] &&
+          -2 == fires.tag[2] && -3 == fires.tag[3]);
+
+    /* then tick by tick, the periodic timer skipped to 1002000 */
+    for (i = 1000001; i <= 1200000; ++ i) {
+        Clock32::t = i;
+        count = fires.count;
+        engine.check();
+
+        if (count != fires.count)
+            late |= (1 == fires.tag[count]) ? (0 != i % 3000)
+                                            : (1199000 != i);
+    }
+
+    /* 67 periodic fires, from 1002000 to 1200000, and the last one-shot */
+    CHECK(! late);
+    CHECK(4 + 67 + 1 == fires.count);
+
+    printf("  %s: 1000000 ticks gap ok, check() in %.0f ns\n",
+           name, gap_ns);
+}
+
+/* -- statistics ----------------------------------------------------------- */
+
+/* the figures of a one-shot timer outlive it, until its slot is reused */
+template <class Engine>
+static void test_stats(const char *name)
+{
+    static Engine engine;
+    int oneshot = -1;
+    timer_stats_t stats;
+
+    Clock32::t = 0;
+    memset(&fires, 0, sizeof(fires));
+
+    engine.init(5, TIMER_CATCHUP_BURST);
+    timer_core_id_t id = engine.schedule(10, record<unsigned long>,
+                                         &oneshot);
+    CHECK(-1 == engine.stats(id, &stats)); /* never fired */
+
+    Clock32::t = 12;
+    engine.check();
+
+    CHECK(1 == fires.count);
+    CHECK(-1 == engine.cancel(id));
+    CHECK(0 == engine.stats(id, &stats));
+    CHECK(1 == stats.fires && 2 == stats.lateness_max);
+
+    /* the slot goes to the next timer (free slots are reused last out
+       first), the old id is stale */
+    engine.schedule(10, record<unsigned long>, &oneshot);
+    CHECK(-1 == engine.stats(id, &stats));
+
+    printf("  %s: expired one-shot stats ok\n", name);
+}
+
+/* -- scheduling cost ------------------------------------------------------- */
+
+/* The sorted active list Timers had before the heap, on a tick source
+   as the engines are, and with deadlines compared across the wrap by
+   timer_core_before() instead of its is_future flags. Schedule inserts
+   in order, cancel searches by id. Only bench() uses it, as the
+   baseline. */
+template <class Clock, int N>
+class TimerList {
+public:
+    typedef typename Clock::ticks_t ticks_t;
+    typedef int handler_t(timer_core_id_t id, ticks_t now, void *ctx);
+
+    int init(int max_simultaneous_timeouts, timer_catchup_t unused)
+    {
+        int i;
+
+        _free_list = _active_list = NULL;
+        for (i = N - 1; 0 <= i; -- i) {
+            _array[i].next = _free_list;
+            _free_list = &_array[i];
+        }
+
+        _max_timeouts = max_simultaneous_timeouts;
+        _next_id = 0;
+
+        return 0;
+    }
+
+    timer_core_id_t schedule(ticks_t dly, handler_t handler, void *user_data)
+    {
+        slot_t *elem = _free_list;
+        if (NULL == elem)
+            return -1;
+
+        _free_list = elem->next;
+        elem->id = _next_id ++;
+        elem->deadline = Clock::now() + dly;
+        elem->dly = dly;
+        elem->handler = handler;
+        elem->user_data = user_data;
+        insert(elem);
+
+        return elem->id;
+    }
+
+    int cancel(timer_core_id_t id)
+    {
+        slot_t **link;
+
+        for (link = &_active_list; NULL != *link; link = &(*link)->next) {
+            if (id == (*link)->id) {
+                release(link);
+                return 0;
+            }
+        }
+
+        return -1; /* not found */
+    }
+
+    ticks_t next_deadline()
+    {
+        ticks_t now = Clock::now();
+
+        if (NULL == _active_list)
+            return (ticks_t) ~(ticks_t) 0;
+
+        return timer_core_before(now, _active_list->deadline)
+            ? _active_list->deadline - now : 0;
+    }
+
+    void check()
+    {
+        int count = _max_timeouts;
+        ticks_t now = Clock::now();
+        slot_t *head;
+
+        while (NULL != (head = _active_list) &&
+               ! timer_core_before(now, head->deadline)) {
+            if (! head->handler(head->id, now, head->user_data))
+                release(&_active_list);
+            else {
+                /* reschedule */
+                _active_list = head->next;
+                head->deadline += head->dly;
+                insert(head);
+            }
+
+            if (0 == -- count)
+                break;
+        }
+    }
+
+private:
+    typedef struct slot_tag {
+        timer_core_id_t id;
+        ticks_t deadline;
+        ticks_t dly;
+        handler_t *handler;
+        void *user_data;
+        struct slot_tag *next;
+    } slot_t;
+
+    /* sorted insertion, after the timers due at the same time */
+    void insert(slot_t *elem)
+    {
+        slot_t **link = &_active_list;
+
+        while (NULL != *link &&
+               ! timer_core_before(elem->deadline, (*link)->deadline))
+            link = &(*link)->next;
+
+        elem->next = *link;
+        *link = elem;
+    }
+
+    /* unlinks the timer at link, back into the free list */
+    void release(slot_t **link)
+    {
+        slot_t *timer = *link;
+
+        *link = timer->next;
+        timer->next = _free_list;
+        _free_list = timer;
+    }
+
+    slot_t _array[N];
+    slot_t *_free_list;
+    slot_t *_active_list;
+    int _max_timeouts;
+    timer_core_id_t _next_id;
+};
+
+static unsigned long rand_state = 1;
+
+static unsigned long rand_ticks(unsigned long max)
+{
+    rand_state = rand_state * 1103515245UL + 12345;
+    return 1 + (rand_state >> 16) % max;
+}
+
+static int order_ok;
+static unsigned long order_last;
+
+static int count_fire(timer_core_id_t id, unsigned long now, void *ctx)
+{
+    order_ok &= (order_last <= now);
+    order_last = now;
+    ++ fires.count;
+    return 0;
+}
+
+/* schedule and cancel, then expiry with the clock going one tick per
+   check() as in a loop() invoked every millisecond. Prints host ns per
+   operation */
+template <class Engine>
+static void bench(const char *name, int n)
+{
+    static Engine engine;
+    static timer_core_id_t ids[TIMER_CORE_MAX_SLOTS];
+    const int rounds = 20000 / n;
+    const unsigned long span = 1000;
+    double t0, sched, expiry;
+    int r, i;
+
+    Clock32::t = 0;
+    engine.init(TIMER_CORE_MAX_SLOTS, TIMER_CATCHUP_BURST);
+
+    t0 = check_ns();
+    for (r = 0; r < rounds; ++ r) {
+        for (i = 0; i < n; ++ i)
+            ids[i] = engine.schedule(rand_ticks(span), count_fire, NULL);
+
+        for (i = 0; i < n; ++ i)
+            engine.cancel(ids[(i * 7) % n]); /* n is not a multiple of 7 */
+    }
+    sched = (check_ns() - t0) / rounds / n;
+
+    fires.count = 0;
+    order_ok = 1;
+    t0 = check_ns();
+    for (r = 0; r < rounds; ++ r) {
+        unsigned long end = Clock32::t + span;
+
+        order_last = Clock32::t;
+        for (i = 0; i < n; ++ i)
+            engine.schedule(rand_ticks(span), count_fire, NULL);
+
+        while (Clock32::t != end) {
+            ++ Clock32::t;
+            engine.check();
+        }
+    }
+    expiry = (check_ns() - t0) / rounds / n;
+
+    CHECK(rounds * n == fires.count);
+    CHECK(order_ok);
+    CHECK((unsigned long) ~0UL == engine.next_deadline());
+
+    printf("  %s n=%3d: schedule+cancel %6.0f ns, expiry %6.0f ns "
+           "(a check() every tick)\n", name, n, sched, expiry);
+}
+
+/* -- main ------------------------------------------------------------------ */
+int main()
+{
+    /* 255 is as far as the engines go: slots are linked by 8-bit
+       indexes (see TimerCore.h) */
+    const int sizes[] = { 10, 100, 255 };
+    unsigned i;
+
+    test_wrap_32< TimerHeap<Clock32, 4> >("heap");
+    test_wrap_32< TimerWheel<Clock32, 4> >("wheel");
+    test_wrap_16< TimerHeap<Clock16, 4> >("heap");
+    test_wrap_16< TimerWheel<Clock16, 4> >("wheel");
+    test_burst< TimerHeap<Clock32, 4> >("heap");
+    test_burst< TimerWheel<Clock32, 4> >("wheel");
+    test_unlimited< TimerHeap<Clock32, 32> >("heap");
+    test_unlimited< TimerWheel<Clock32, 32> >("wheel");
+    test_zero< TimerHeap<Clock32, 4> >("heap");
+    test_zero< TimerWheel<Clock32, 4> >("wheel");
+    test_gap< TimerHeap<Clock32, 8> >("heap");
+    test_gap< TimerWheel<Clock32, 8> >("wheel");
+    test_stats< TimerHeap<Clock32, 4, TimerStats<4> > >("heap");
+    test_stats< TimerWheel<Clock32, 4, TimerStats<4> > >("wheel");
+
+    for (i = 0; i < sizeof(sizes) / sizeof(sizes[0]); ++ i) {
+        bench< TimerList<Clock32, TIMER_CORE_MAX_SLOTS> >("list ", sizes[i]);
+        bench< TimerHeap<Clock32, TIMER_CORE_MAX_SLOTS> >("heap ", sizes[i]);
+        bench< TimerWheel<Clock32, TIMER_CORE_MAX_SLOTS> >("wheel", sizes[i]);
+    }
+
+    return check_status();
+}
@@ -23,51 +23,75 @@
 #ifndef uTIMERS_H_DEFINED
 #define uTIMERS_H_DEFINED
 
+#include <TimerCore.h>
+#include <TimerStats.h>
+
 const int MAX_MICRO_TIMERS = 20;
 const int MICRO_TIMERS_DEFAULT_MAX_SIMULTANEOUS_TIMEOUTS = 1;
 
+/* Uncomment the following line to record per timer dispatch statistics
+   and a trace of the latest fires (see TimerStats.h). When commented out
+   the statistics hooks compile to nothing. */
+/* #define UTIMERS_STATS */
+
 /* -- custom typedefs ------------------------------------------------------- */
 
-typedef short utimer_id_t;
+/* timer ids are generation-tagged slot indexes (see TimerCore.h) */
+typedef long utimer_id_t;
 typedef unsigned long uticks_t;
 typedef int utimer_handler_t(utimer_id_t id, uticks_t now, void *ctx);
 
-typedef struct timer_TAG {
-
-    /** timer ID */
-    utimer_id_t id;
-
-    /** delay (ms) */
-    uticks_t dly;
-
-    /** current time when timer was started */
-    uticks_t base;
-
-    /** Scheduled time action */
-    utimer_handler_t *handler;
-
-    /** Reserved for the user */
-    void *user_data;
-
-    struct timer_TAG *next;
-} utimer_t;
-
 /* -- public interface ------------------------------------------------------ */
 
 /** returns true if lib is initialized, false otherwise */
 int utimers_is_initialized();
 
-/** initializes the library. Must be invoked once, before using the library */
+/** initializes the library. Must be invoked once, before using the library.
+    catchup tells what to do with the periods a late periodic timer missed */
 int utimers_init(int max_simultaneous_timeouts =
-                 MICRO_TIMERS_DEFAULT_MAX_SIMULTANEOUS_TIMEOUTS);
+                 MICRO_TIMERS_DEFAULT_MAX_SIMULTANEOUS_TIMEOUTS,
+                 timer_catchup_t catchup = TIMER_CATCHUP_BURST);
 
-/** schedules a delayed action. returns timer id if succesful, -1 otherwise */
+/** schedules a delayed action. returns timer id if succesful, -1 otherwise.
+    dly must stay below half the uticks_t range (about 35 minutes) */
 utimer_id_t utimers_schedule(uticks_t dly, utimer_handler_t handler,
                              void *user_data);
 
-/** returns number of milliseconds before expiration */
+/** returns number of microseconds before expiration, 0 if already
+    expired, all ones if not found */
 uticks_t utimers_timeleft(utimer_id_t id);
 
+/** returns number of microseconds before the earliest expiration, 0 if a
+    timer is already due, all ones if no timer is active */
+uticks_t utimers_next_deadline();
+
+/** returns the worst lateness observed for a timer so far, saturated to
+    0xFFFF ticks; all ones if not found */
+uticks_t utimers_jitter(utimer_id_t id);
+
+/** sets a time budget for each utimers_check() pass, in microseconds.
+    While non zero, handlers keep firing until the budget is spent instead
+    of up to max_simultaneous_timeouts per pass. 0 (the default) restores
+    the count based limit */
+void utimers_set_budget(unsigned long usecs);
+
+/** fills stats with the dispatch overrun counters: expirations left
+    waiting by a pass are deferred to the next one and run first */
+void utimers_overrun(timer_overrun_t *stats);
+
+/** fills stats with lateness and execution time figures of a timer,
+    expired one-shot timers included until their slot is reused. Returns
+    0 if succesful, -1 if not found, if it never fired or if
+    UTIMERS_STATS is not defined */
+int utimers_stats(utimer_id_t id, timer_stats_t *stats);
+
+/** fills trace with the i-th most recent fire, 0 being the latest.
+    Returns 0 if succesful, -1 otherwise */
+int utimers_trace(int i, timer_trace_t *trace);
+
+/** prints statistics of all timers and the trace to out, e.g. Serial */
+void utimers_dump_stats(Print &out);
+
 /** cancels an existing timer. Returns 0 if succesful, -1 otherwise */
 int utimers_cancel(utimer_id_t id);
 
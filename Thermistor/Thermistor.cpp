@@ -0,0 +1,67 @@
+/**
+ * @file Thermistor.cpp
+ * @brief Thermistor library implementation
+ *
+ * Copyright (C) 2013 Marco Pensallorto
+ * < marco DOT pensallorto AT gmail DOT com >
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+**/
+#include <Thermistor.h>
+
+/* table layout, see thermistor_table.py */
+#define THERMISTOR_STEP_BITS 3 /* 8 ADC counts between entries */
+#define THERMISTOR_ENTRIES   (1024 / (1 << THERMISTOR_STEP_BITS) + 1)
+
+/* temperatures (C/100) every 8 ADC counts, from 0 to 1024. Generated by
+   thermistor_table.py, do not edit */
+static const int16_t table[THERMISTOR_ENTRIES] PROGMEM = {
+     -8346,  -5445,  -4567,  -4016,  -3605,  -3274,  -2993,  -2749,
+     -2532,  -2336,  -2156,  -1989,  -1834,  -1688,  -1551,  -1420,
+     -1296,  -1176,  -1062,   -952,   -846,   -743,   -643,   -546,
+      -452,   -360,   -270,   -182,    -96,    -12,     71,    152,
+       233,    312,    390,    466,    542,    617,    692,    765,
+       838,    910,    982,   1053,   1124,   1194,   1264,   1334,
+      1403,   1472,   1541,   1610,   1678,   1747,   1815,   1884,
+      1952,   2021,   2089,   2158,   2227,   2296,   2365,   2435,
+      2504,   2575,   2645,   2716,   2787,   2859,   2932,   3004,
+      3078,   3152,   3227,   3303,   3379,   3457,   3535,   3614,
+      3694,   3776,   3858,   3942,   4027,   4113,   4201,   4291,
+      4382,   4475,   4570,   4667,   4766,   4868,   4972,   5078,
+      5188,   5301,   5416,   5536,   5659,   5787,   5919,   6057,
+      6199,   6348,   6503,   6665,   6836,   7015,   7205,   7406,
+      7619,   7848,   8094,   8359,   8648,   8965,   9316,   9709,
+     10155,  10671,  11281,  12025,  12973,  14265,  16249,  20264,
+     32767,
+};
+
+int thermistor_centi(unsigned int adc)
+{
+    const int shift = THERMISTOR_FRAC_BITS + THERMISTOR_STEP_BITS;
+    unsigned int i = adc >> shift;
+    unsigned int frac = adc & ((1 << shift) - 1);
+    int t0, t1;
+
+    if (THERMISTOR_ENTRIES - 1 <= i)
+        return (int16_t) pgm_read_word(&table[THERMISTOR_ENTRIES - 1]);
+
+    t0 = (int16_t) pgm_read_word(&table[i]);
+    t1 = (int16_t) pgm_read_word(&table[i + 1]);
+
+    /* rounded, the table is increasing */
+    return t0 + (int) ((((long) t1 - t0) * frac + (1 << (shift - 1)))
+                       >> shift);
+}
@@ -0,0 +1,52 @@
+/**
+ * @file Thermistor.h
+ * @brief Thermistor temperature lookup, in fixed point
+ *
+ * Copyright (C) 2013 Marco Pensallorto
+ * < marco DOT pensallorto AT gmail DOT com >
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+**/
+#ifndef THERMISTOR_H_DEFINED
+#define THERMISTOR_H_DEFINED
+
+#include <Arduino.h>
+
+/* Converts readings of a B = 3975, 10k NTC thermistor in a divider with a
+   10k resistor to temperatures, in hundredths of a Celsius degree. A
+   table of the temperatures every 8 ADC counts lives in flash (see
+   thermistor_table.py), values in between are interpolated linearly:
+   no floating point, no log(). The result stays within 0.05 C of the B
+   formula from -10 to 90 C. */
+
+/* readings are passed in fixed point with this many fractional bits, so
+   that averages keep their fraction */
+const int THERMISTOR_FRAC_BITS = 4;
+
+/* -- public interface ------------------------------------------------------ */
+
+/** returns the temperature for reading adc (with THERMISTOR_FRAC_BITS
+    fractional bits) in hundredths of a Celsius degree */
+int thermistor_centi(unsigned int adc);
+
+/** returns the average of n readings adding up to sum, with
+    THERMISTOR_FRAC_BITS fractional bits */
+inline unsigned int thermistor_adc(unsigned long sum, unsigned char n)
+{
+    return ((sum << THERMISTOR_FRAC_BITS) + n / 2) / n;
+}
+
+#endif
@@ -0,0 +1,32 @@
+#!/usr/bin/env python
+#
+# Generates the ADC to temperature table of Thermistor.cpp, paste the
+# output over the table body when changing the thermistor parameters.
+#
+# Copyright (C) 2013 Marco Pensallorto
+# < marco DOT pensallorto AT gmail DOT com >
+#
+# This library is free software; you can redistribute it and/or
+# modify it under the terms of the GNU Lesser General Public
+# License as published by the Free Software Foundation; either
+# version 2.1 of the License, or (at your option) any later version.
+import math
+
+B = 3975             # thermistor B coefficient
+R0 = 10000.0         # thermistor resistance at T0, and divider resistance
+T0 = 298.15          # K
+ADC_MAX = 1023
+STEP = 8             # ADC counts between entries, see THERMISTOR_STEP
+
+def celsius(adc):
+    # the divider is singular at both ends of the ADC range
+    adc = min(max(adc, 0.5), ADC_MAX - 0.5)
+    r = (ADC_MAX - adc) * R0 / adc
+    return 1 / (math.log(r / R0) / B + 1 / T0) - 273.15
+
+def centi(adc):
+    return max(-32768, min(32767, int(round(celsius(adc) * 100))))
+
+table = [centi(i * STEP) for i in range((ADC_MAX + 1) // STEP + 1)]
+for i in range(0, len(table), 8):
+    print('    ' + ' '.join('%6d,' % t for t in table[i:i + 8]))
@@ -0,0 +1 @@
+../Control/Control.cpp
\ No newline at end of file
@@ -0,0 +1 @@
+../Control/Control.h
\ No newline at end of file
@@ -0,0 +1 @@
+../Debouncers/DebounceButton.h
\ No newline at end of file
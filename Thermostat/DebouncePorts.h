@@ -0,0 +1 @@
+../Debouncers/DebouncePorts.h
\ No newline at end of file
@@ -0,0 +1 @@
+../Debouncers/DebouncerBank.h
\ No newline at end of file
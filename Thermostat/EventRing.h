@@ -0,0 +1 @@
+../Events/EventRing.h
\ No newline at end of file
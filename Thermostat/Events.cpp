@@ -0,0 +1 @@
+../Events/Events.cpp
\ No newline at end of file
@@ -0,0 +1 @@
+../Events/Events.h
\ No newline at end of file
@@ -0,0 +1 @@
+../Filters/MovingAverage.h
\ No newline at end of file
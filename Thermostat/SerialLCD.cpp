@@ -42,199 +42,517 @@
 #endif
 #include "SerialLCD.h"
 
+// Commands are not sent right away: they are queued as bytes, with the
+// handshakes of the protocol (waiting for an ACK, giving the module time
+// to process a command) encoded by an escape byte, followed by:
+//  - SLCD_Q_ACK, wait for SLCD_CURSOR_ACK, at most SLCD_ACK_TIMEOUT ms;
+//  - SLCD_Q_DELAY and n, wait n ms;
+//  - SLCD_Q_ESCAPE, a literal escape byte.
+// poll() drains the queue, a few bytes at a time, and never blocks on a
+// handshake. A command is queued whole or not at all: when the queue is
+// full it is dropped and counted (see overflows()), nothing blocks.
+#define SLCD_Q_ESCAPE		0xF0
+#define SLCD_Q_ACK		0x01
+#define SLCD_Q_DELAY		0x02
+
+#define SLCD_Q_MASK		(SLCD_TX_QUEUE_SIZE - 1)
+
+// Handshake states
+#define SLCD_STATE_READY	0
+#define SLCD_STATE_ACK		1
+#define SLCD_STATE_DELAY	2
+
 SerialLCD::SerialLCD(uint8_t rx, uint8_t tx):SERIAL_LIB(rx,tx)
 {
+    _txq_head = _txq_tail = 0;
+    _state = SLCD_STATE_READY;
+    _timeouts = 0;
+    _overflows = 0;
+    _run = 0;
+    _buffered = 0;
+}
+
+/********** Transmit queue **********/
+
+// Send queued bytes and run handshakes, at most SLCD_TX_BURST bytes per
+// call. Returns 1 while work remains, 0 when idle
+int SerialLCD::poll()
+{
+    uint8_t burst = SLCD_TX_BURST;
+    uint8_t b;
+
+    while (1) {
+        switch (_state) {
+        case SLCD_STATE_ACK:
+            while (SERIAL_LIB::available() > 0) {
+                if (SERIAL_LIB::read() == SLCD_CURSOR_ACK) {
+                    _state = SLCD_STATE_READY;
+                    break;
+                }
+            }
+            if (_state == SLCD_STATE_ACK) {
+                if (millis() - _wait_start < SLCD_ACK_TIMEOUT)
+                    return 1;
+
+                // no ACK, give up and go on with the command
+                ++ _timeouts;
+                _state = SLCD_STATE_READY;
+            }
+            break;
+
+        case SLCD_STATE_DELAY:
+            if (millis() - _wait_start < _wait_ms)
+                return 1;
+
+            _state = SLCD_STATE_READY;
+            break;
+
+        default:
+            if (_txq_head == _txq_tail)
+                return 0;
+
+            if (0 == burst)
+                return 1;
+
+            b = pop();
+            if (b == SLCD_Q_ESCAPE) {
+                switch (pop()) {
+                case SLCD_Q_ACK:
+                    _state = SLCD_STATE_ACK;
+                    _wait_start = millis();
+                    continue;
+
+                case SLCD_Q_DELAY:
+                    _state = SLCD_STATE_DELAY;
+                    _wait_ms = pop();
+                    _wait_start = millis();
+                    continue;
+
+                default: // SLCD_Q_ESCAPE
+                    break;
+                }
+            }
+
+            SLCD_SEND(b);
+            -- burst;
+        }
+    }
+}
+
+// Send all queued commands, blocking. Bounded by the handshake timeouts
+void SerialLCD::drain()
+{
+    while (poll())
+        ;
+}
+
+unsigned int SerialLCD::timeouts()
+{
+    return _timeouts;
+}
+
+unsigned int SerialLCD::overflows()
+{
+    return _overflows;
+}
+
+// Check that n bytes fit in the queue. Commands reserve all their bytes
+// up front, poll() never sees half of one. Returns 0 if they fit, -1
+// (and counts an overflow) if not
+int SerialLCD::reserve(uint8_t n)
+{
+    if ((uint8_t) (SLCD_TX_QUEUE_SIZE - 1 - ((_txq_head - _txq_tail) & SLCD_Q_MASK)) < n) {
+        ++ _overflows;
+        return -1;
+    }
+
+    return 0;
+}
+
+void SerialLCD::push(uint8_t b)
+{
+    _txq[_txq_head] = b;
+    _txq_head = (_txq_head + 1) & SLCD_Q_MASK;
+}
+
+uint8_t SerialLCD::pop()
+{
+    uint8_t b = _txq[_txq_tail];
+    _txq_tail = (_txq_tail + 1) & SLCD_Q_MASK;
+    return b;
+}
+
+// The send functions below return 0 if queued, -1 if dropped
+int SerialLCD::send(uint8_t b)
+{
+    if (b == SLCD_Q_ESCAPE) {
+        if (reserve(2))
+            return -1;
+        push(SLCD_Q_ESCAPE);
+        push(SLCD_Q_ESCAPE);
+        return 0;
+    }
+
+    if (reserve(1))
+        return -1;
+    push(b);
+    return 0;
+}
+
+// Send a command, this ends any run of chars
+int SerialLCD::sendCommand(uint8_t cmd)
+{
+    if (reserve(2))
+        return -1;
+
+    _run = 0;
+    send(SLCD_CONTROL_HEADER);
+    send(cmd);
+    return 0;
+}
+
+// Send chars in runs, up to SLCD_MAX_RUN chars under a single char header
+// rather than one header per char. A char that reads as a header is sent
+// alone, under its own header
+int SerialLCD::sendText(uint8_t b)
+{
+    // a header, and the char escaped at worst
+    if (reserve(3))
+        return -1;
+
+    if (b == SLCD_CONTROL_HEADER || b == SLCD_CHAR_HEADER ||
+        b == SLCD_CURSOR_HEADER) {
+        _run = 0;
+        send(SLCD_CHAR_HEADER);
+        send(b);
+        return 0;
+    }
+
+    if (0 == _run || SLCD_MAX_RUN <= _run) {
+        _run = 0;
+        send(SLCD_CHAR_HEADER);
+    }
+
+    send(b);
+    ++ _run;
+    return 0;
+}
+
+void SerialLCD::sendText(const char b[])
+{
+    while (*b)
+        sendText((uint8_t) *b++);
+}
+
+int SerialLCD::sendDelay(uint8_t ms)
+{
+    if (reserve(3))
+        return -1;
+    push(SLCD_Q_ESCAPE);
+    push(SLCD_Q_DELAY);
+    push(ms);
+    return 0;
+}
+
+int SerialLCD::sendWaitAck()
+{
+    if (reserve(2))
+        return -1;
+    push(SLCD_Q_ESCAPE);
+    push(SLCD_Q_ACK);
+    return 0;
+}
+
+
+/********** Shadow framebuffer **********/
+
+// In buffered mode, print(), setCursor(), clear() and home() only write
+// into a framebuffer. refresh() compares it to what was last sent, and
+// sends the cells that changed: runs of changed cells are coalesced
+// across up to SLCD_FB_GAP unchanged ones, and the cursor is moved only
+// when the display one is not already there. When the queue fills up the
+// cells left are sent by the next refresh().
 
+// Enter buffered mode, the first refresh() redraws the whole display
+void SerialLCD::buffer()
+{
+    memset(_fb, ' ', sizeof(_fb));
+    memset(_lcd, 0, sizeof(_lcd)); // matches no character
+    _fb_col = _fb_row = 0;
+    _lcd_col = _lcd_row = 0xFF; // unknown
+    _buffered = 1;
+}
+
+// Leave buffered mode, commands are sent right away again
+void SerialLCD::noBuffer()
+{
+    _buffered = 0;
 }
 
+// Send the cells written since the last refresh(). Returns 1 if the
+// queue filled up before all of them were sent, 0 otherwise
+int SerialLCD::refresh()
+{
+    uint8_t row, col, end, next;
+
+    for (row = 0; row < SLCD_ROWS; ++ row) {
+        col = 0;
+        while (1) {
+            // first changed cell
+            while (col < SLCD_COLS && _fb[row][col] == _lcd[row][col])
+                ++ col;
+            if (col == SLCD_COLS)
+                break;
+
+            // extend the run, up to the last changed cell before a
+            // long enough gap
+            end = next = col + 1;
+            while (next < SLCD_COLS && next - end < SLCD_FB_GAP) {
+                if (_fb[row][next] != _lcd[row][next])
+                    end = next + 1;
+                ++ next;
+            }
+
+            if (_lcd_row != row || _lcd_col != col) {
+                if (sendCursor(col, row))
+                    return 1;
+
+                _lcd_col = col;
+                _lcd_row = row;
+            }
+
+            for (; col < end; ++ col) {
+                if (sendText(_fb[row][col]))
+                    return 1;
+
+                _lcd[row][col] = _fb[row][col];
+                ++ _lcd_col;
+            }
+        }
+    }
+
+    return 0;
+}
+
+// Write a character at the cursor of the framebuffer, characters past the
+// end of the row are dropped
+void SerialLCD::fbWrite(uint8_t b)
+{
+    if (_fb_col < SLCD_COLS) {
+        _fb[_fb_row][_fb_col] = b;
+        ++ _fb_col;
+    }
+}
 
 /********** High level commands, for the user! **********/
 
 // Initialize the Serial LCD Driver. SerialLCD Module initiates the communication.
-void SerialLCD::begin()
+// Blocks for SLCD_INIT_TIMEOUT ms at most. Returns 0 if succesful, -1 if the
+// module did not answer
+int SerialLCD::begin()
 {
+    unsigned long start;
+
     SERIAL_LIB::begin(9600);
     delay(2);
     noPower();
-    delay(1);
+    sendDelay(1);
     power();
     backlight();
-    delay(1);
-//    SLCD_SEND(SLCD_CONTROL_HEADER);   
-    SLCD_SEND(SLCD_INIT_ACK);
+    sendDelay(1);
+//    send(SLCD_CONTROL_HEADER);   
+    _run = 0;
+    send(SLCD_INIT_ACK);
+    drain();
+
+    start = millis();
     while(1)
     {
         if (SERIAL_LIB::available() > 0 && SERIAL_LIB::read()==SLCD_INIT_DONE)
             break;
+
+        if (millis() - start >= SLCD_INIT_TIMEOUT) {
+            ++ _timeouts;
+            return -1;
+        }
     }
-    delay(2);
+    sendDelay(2);
+    return 0;
 }
 
 //Turn off the back light
 void SerialLCD::noBacklight()
 {
-    SLCD_SEND(SLCD_CONTROL_HEADER);   
-    SLCD_SEND(SLCD_BACKLIGHT_OFF);   
+    sendCommand(SLCD_BACKLIGHT_OFF);   
 }
 
 //Turn on the back light
 void SerialLCD::backlight()
 {
-    SLCD_SEND(SLCD_CONTROL_HEADER);   
-    SLCD_SEND(SLCD_BACKLIGHT_ON);   
+    sendCommand(SLCD_BACKLIGHT_ON);   
 }
 
 //Turn off the LCD
 void SerialLCD::power()
 {
-    SLCD_SEND(SLCD_CONTROL_HEADER);   
-    SLCD_SEND(SLCD_POWER_ON);   
+    sendCommand(SLCD_POWER_ON);   
 }
 
 //Turn on the LCD
 void SerialLCD::noPower()
 {
-    SLCD_SEND(SLCD_CONTROL_HEADER);   
-    SLCD_SEND(SLCD_POWER_OFF);   
+    sendCommand(SLCD_POWER_OFF);   
 }
 
 // Clear the display
 void SerialLCD::clear()
 {
-    SLCD_SEND(SLCD_CONTROL_HEADER);   
-    SLCD_SEND(SLCD_CLEAR_DISPLAY);
-    delay(2);//this command needs more time;  
+    if (_buffered) {
+        memset(_fb, ' ', sizeof(_fb));
+        _fb_col = _fb_row = 0;
+        return;
+    }
+
+    sendCommand(SLCD_CLEAR_DISPLAY);
+    sendDelay(2);//this command needs more time;  
 }
 
 // Return to home(top-left corner of LCD)
 void SerialLCD::home()
 {
-    SLCD_SEND(SLCD_CONTROL_HEADER);
-    SLCD_SEND(SLCD_RETURN_HOME);  
-    delay(2);//this command needs more time;  
+    if (_buffered) {
+        _fb_col = _fb_row = 0;
+        return;
+    }
+
+    sendCommand(SLCD_RETURN_HOME);  
+    sendDelay(2);//this command needs more time;  
 }
 
 // Set Cursor to (Column,Row) Position
 void SerialLCD::setCursor(uint8_t column, uint8_t row)
 {
-    delay(2);//this command needs more time;  
-    SLCD_SEND(SLCD_CONTROL_HEADER); 
-    SLCD_SEND(SLCD_CURSOR_HEADER); //cursor header command
-    while(1)
-    {
-        if (SERIAL_LIB::available() > 0 && SERIAL_LIB::read()==SLCD_CURSOR_ACK)
-            break;
+    if (_buffered) {
+        _fb_col = column < SLCD_COLS ? column : SLCD_COLS;
+        _fb_row = row < SLCD_ROWS ? row : SLCD_ROWS - 1;
+        return;
     }
-    SLCD_SEND(column);
-    SLCD_SEND(row);
+
+    sendCursor(column, row);
+}
+
+int SerialLCD::sendCursor(uint8_t column, uint8_t row)
+{
+    // two delays, commands, handshakes, and column and row escaped at worst
+    if (reserve(2 * (3 + 2 + 2 + 4)))
+        return -1;
+
+    sendDelay(2);//this command needs more time;  
+    sendCommand(SLCD_CURSOR_HEADER); //cursor header command
+    sendWaitAck();
+    send(column);
+    send(row);
 //one more to make sure the cursor is right
-    delay(2);//this command needs more time;  
-    SLCD_SEND(SLCD_CONTROL_HEADER); 
-    SLCD_SEND(SLCD_CURSOR_HEADER); //cursor header command
-    while(1)
-    {
-        if (SERIAL_LIB::available() > 0 && SERIAL_LIB::read()==SLCD_CURSOR_ACK)
-            break;
-    }
-    SLCD_SEND(column);
-    SLCD_SEND(row);
+    sendDelay(2);//this command needs more time;  
+    sendCommand(SLCD_CURSOR_HEADER); //cursor header command
+    sendWaitAck();
+    send(column);
+    send(row);
+    return 0;
 }
 
 // Switch the display off without clearing RAM
 void SerialLCD::noDisplay() 
 {
-    SLCD_SEND(SLCD_CONTROL_HEADER);
-    SLCD_SEND(SLCD_DISPLAY_OFF);    
+    sendCommand(SLCD_DISPLAY_OFF);    
 }
 
 // Switch the display on
 void SerialLCD::display() 
 {
-    SLCD_SEND(SLCD_CONTROL_HEADER);
-    SLCD_SEND(SLCD_DISPLAY_ON);    
+    sendCommand(SLCD_DISPLAY_ON);    
 }
 
 // Switch the underline cursor off
 void SerialLCD::noCursor() 
 {
-    SLCD_SEND(SLCD_CONTROL_HEADER);
-    SLCD_SEND(SLCD_CURSOR_OFF);     
+    sendCommand(SLCD_CURSOR_OFF);     
 }
 
 // Switch the underline cursor on
 void SerialLCD::cursor() 
 {
-    SLCD_SEND(SLCD_CONTROL_HEADER);
-    SLCD_SEND(SLCD_CURSOR_ON);     
+    sendCommand(SLCD_CURSOR_ON);     
 }
 
 // Switch off the blinking cursor
 void SerialLCD::noBlink() 
 {
-    SLCD_SEND(SLCD_CONTROL_HEADER);
-    SLCD_SEND(SLCD_BLINK_OFF);     
+    sendCommand(SLCD_BLINK_OFF);     
 }
 
 // Switch on the blinking cursor
 void SerialLCD::blink() 
 {
-    SLCD_SEND(SLCD_CONTROL_HEADER);
-    SLCD_SEND(SLCD_BLINK_ON);     
+    sendCommand(SLCD_BLINK_ON);     
 }
 
 // Scroll the display left without changing the RAM
 void SerialLCD::scrollDisplayLeft(void) 
 {
-    SLCD_SEND(SLCD_CONTROL_HEADER);
-    SLCD_SEND(SLCD_SCROLL_LEFT);
+    sendCommand(SLCD_SCROLL_LEFT);
 }
 
 // Scroll the display right without changing the RAM
 void SerialLCD::scrollDisplayRight(void) 
 {
-    SLCD_SEND(SLCD_CONTROL_HEADER);
-    SLCD_SEND(SLCD_SCROLL_RIGHT);
+    sendCommand(SLCD_SCROLL_RIGHT);
 }
 
 // Set the text flow "Left to Right"
 void SerialLCD::leftToRight(void) 
 {
-    SLCD_SEND(SLCD_CONTROL_HEADER);
-    SLCD_SEND(SLCD_LEFT_TO_RIGHT);
+    sendCommand(SLCD_LEFT_TO_RIGHT);
 }
 
 // Set the text flow "Right to Left"
 void SerialLCD::rightToLeft(void) 
 {
-    SLCD_SEND(SLCD_CONTROL_HEADER);
-    SLCD_SEND(SLCD_RIGHT_TO_LEFT);
+    sendCommand(SLCD_RIGHT_TO_LEFT);
 }
 
 // This will 'right justify' text from the cursor
 void SerialLCD::autoscroll(void) 
 {
-    SLCD_SEND(SLCD_CONTROL_HEADER);
-    SLCD_SEND(SLCD_AUTO_SCROLL);
+    sendCommand(SLCD_AUTO_SCROLL);
 }
 
 // This will 'left justify' text from the cursor
 void SerialLCD::noAutoscroll(void) 
 {
-    SLCD_SEND(SLCD_CONTROL_HEADER);
-    SLCD_SEND(SLCD_NO_AUTO_SCROLL);
+    sendCommand(SLCD_NO_AUTO_SCROLL);
 }
 
 // Print Commands
 
 void SerialLCD::print(uint8_t b)
 {
-    SLCD_SEND(SLCD_CHAR_HEADER);
-    SLCD_SEND(b);
+    if (_buffered) {
+        fbWrite(b);
+        return;
+    }
+
+    sendText(b);
 }
 void SerialLCD::print(const char b[])
 {
-    SLCD_SEND(SLCD_CHAR_HEADER);
-    SLCD_SEND(b);
+    if (_buffered) {
+        while (*b)
+            fbWrite((uint8_t) *b++);
+        return;
+    }
+
+    sendText(b);
 }
 
 void SerialLCD::print(unsigned long n, uint8_t base)
@@ -262,4 +580,48 @@ void SerialLCD::print(unsigned long n, uint8_t base)
                           'A' + buf[i - 1] - 10));
     }
     //delay(1);
-}
\ No newline at end of file
+}
+
+// Print value / 10^decimals, e.g. printFixed(-215, 1) prints "-21.5". The
+// number is rendered with integer math only, and sent as a single string
+void SerialLCD::printFixed(long value, uint8_t decimals)
+{
+    char buf[24]; // sign, 10 digits, point, padding zeros, nul
+    char *p = buf + sizeof(buf);
+    unsigned long n = value < 0 ? - (unsigned long) value : value;
+    uint8_t i = 0;
+
+    if (decimals > sizeof(buf) - 4)
+        decimals = sizeof(buf) - 4;
+
+    *--p = '\0';
+    do {
+        *--p = '0' + n % 10;
+        n /= 10;
+        if (++i == decimals)
+            *--p = '.';
+    } while (n > 0 || i <= decimals);
+
+    if (value < 0)
+        *--p = '-';
+
+    print(p);
+}
+
+// Print number rounded to digits decimals, as a fixed-point number (see
+// printFixed). The integer part must fit a long once scaled
+void SerialLCD::printFloat(double number, uint8_t digits)
+{
+    long scale = 1;
+    uint8_t i;
+
+    if (digits > 9)
+        digits = 9;
+
+    for (i = 0; i < digits; ++i)
+        scale *= 10;
+
+    number *= scale;
+    printFixed(number < 0 ? (long) (number - 0.5) : (long) (number + 0.5),
+               digits);
+}
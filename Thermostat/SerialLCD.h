@@ -71,6 +71,20 @@
 #define SLCD_POWER_ON    	0x83
 #define SLCD_POWER_OFF  	0x82
 
+// Outgoing commands are queued, and sent by poll() (see SerialLCD.cpp)
+#define SLCD_TX_QUEUE_SIZE	128	// bytes, a power of two. Holds a
+					// full redraw of the display
+#define SLCD_TX_BURST		4	// max bytes sent per poll()
+#define SLCD_ACK_TIMEOUT	20	// ms
+#define SLCD_INIT_TIMEOUT	500	// ms
+#define SLCD_MAX_RUN		16	// max chars sent under one header
+
+// Display geometry, and shadow framebuffer tuning (see buffer())
+#define SLCD_COLS		16
+#define SLCD_ROWS		2
+#define SLCD_FB_GAP		8	// max unchanged cells resent, rather
+					// than moving the cursor
+
 
 #if ARDUINO < 100
 class SerialLCD : public NewSoftSerial{
@@ -83,8 +97,9 @@ public:
     
     void autoscroll();
     void backlight();    
-    void begin();
+    int begin();
     void blink();
+    void buffer();
     void clear();
     void cursor();
     void display();
@@ -93,6 +108,7 @@ public:
     void noAutoscroll();
     void noBacklight();
     void noBlink();
+    void noBuffer();
     void noCursor();
     void noDisplay();
     void noPower();        
@@ -100,11 +116,64 @@ public:
     void print(const char[]);
     void print(uint8_t b);
     void print(unsigned long n, uint8_t base);
+    void printFixed(long value, uint8_t decimals);
+    void printFloat(double number, uint8_t digits);
+    int refresh();
     void rightToLeft();
     void scrollDisplayLeft();
     void scrollDisplayRight();
     void setCursor(uint8_t, uint8_t);
 
+    // Sends queued commands, without blocking. To be invoked often, e.g.
+    // from a periodic timer. Returns 1 while work remains, 0 when idle
+    int poll();
+
+    // Sends all queued commands, blocking
+    void drain();
+
+    // Number of handshakes given up on (ACK or init timeouts)
+    unsigned int timeouts();
+
+    // Number of commands dropped, the queue being full
+    unsigned int overflows();
+
+private:
+    int send(uint8_t);
+    int sendCommand(uint8_t);
+    int sendText(uint8_t);
+    void sendText(const char[]);
+    int sendDelay(uint8_t ms);
+    int sendWaitAck();
+    int sendCursor(uint8_t, uint8_t);
+    void fbWrite(uint8_t);
+    int reserve(uint8_t);
+    void push(uint8_t);
+    uint8_t pop();
+
+    uint8_t _txq[SLCD_TX_QUEUE_SIZE];
+    uint8_t _txq_head;
+    uint8_t _txq_tail;
+
+    // Handshake in progress, see poll()
+    uint8_t _state;
+    uint8_t _wait_ms;
+    unsigned long _wait_start;
+
+    // Chars queued under the last char header, 0 if none (see sendText)
+    uint8_t _run;
+
+    unsigned int _timeouts;
+    unsigned int _overflows;
+
+    // Shadow framebuffer: contents and cursor as written by the
+    // application, contents and cursor as last sent to the display
+    uint8_t _buffered;
+    uint8_t _fb[SLCD_ROWS][SLCD_COLS];
+    uint8_t _fb_col;
+    uint8_t _fb_row;
+    uint8_t _lcd[SLCD_ROWS][SLCD_COLS];
+    uint8_t _lcd_col;
+    uint8_t _lcd_row;
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1 @@
+../Thermistor/Thermistor.cpp
\ No newline at end of file
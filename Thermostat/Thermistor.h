@@ -0,0 +1 @@
+../Thermistor/Thermistor.h
\ No newline at end of file
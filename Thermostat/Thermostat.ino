@@ -1,5 +1,9 @@
+#include <Control.h>
 #include <Debug.h>
 #include <Debounce.h>
+#include <Events.h>
+#include <MovingAverage.h>
+#include <Thermistor.h>
 #include <Timers.h>
 
 #include <SerialLCD.h>
@@ -14,6 +18,7 @@ const int TEMP_SAMPLE_PERIOD = 125;
 const int LCD_UPDATE_PERIOD  = 500;
 const int ACT_UPDATE_PERIOD  = 1000;
 const int CLK_PERIOD         = 1000;
+const int LCD_POLL_PERIOD    = 2;
 
 /* -- Helpers --------------------------------------------------------------- */
 #define GOTO_XY(x,y)                                                    \
@@ -36,16 +41,36 @@ const int di_clk_adjust = 8;
 
 const int do_actuate = 4;
 
+/* heater control law (see Control.h), hysteresis by default. Uncomment
+   the following line to use the PID instead */
+/* #define USE_PID */
+
+const temp_t HYST_OFFSET = 20; /* .2 C */
+
+/* PID gains, tuned on a thermal model of a room: full duty at 2 C below
+   the setpoint */
+const int PID_KP = 1280;
+const int PID_KI = 1;
+const int PID_KD = 25600;
+
+/* the relay is on for a duty share of each window, and it is held on
+   and off for a few seconds at least */
+const unsigned long RELAY_WINDOW  = 30000;
+const unsigned long RELAY_MIN_ON  = 3000;
+const unsigned long RELAY_MIN_OFF = 3000;
+
+/* adjusting buttons auto-repeat when held, faster and faster: first
+   repeat after .5s, then every .25s down to .05s (10ms samples) */
+const debounce_timing_t adjust_timing = { 10, 50, 25, 5, 0 };
+
 #ifdef USE_SLCD
 const int slcd_tx = 11;
 const int slcd_rx = 12;
 SerialLCD slcd(slcd_tx, slcd_rx);
-#endif
 
-typedef enum {
-    H_LOW,
-    H_HIGH,
-} hysteresis_t;
+/* true while the LCD poll timer is active (see slcd_flush) */
+int slcd_polling;
+#endif
 
 typedef enum {
     CTL_RUNNING,
@@ -60,17 +85,15 @@ struct tm {
 };
 
 typedef struct {
-    double samples[N_SAMPLES];
-    unsigned short last_sample;
+    /* raw ADC counts, N_SAMPLES x 1023 fits an unsigned int */
+    MovingAverage<N_SAMPLES, unsigned int, unsigned int> samples;
 
     int heartbeat;
     int initialized;
 
-    double curr_temperature;
-    double goal_temperature;
+    temp_t curr_temperature;
+    temp_t goal_temperature;
 
-    double hyst_offset;
-    hysteresis_t  hyst_status;
 
     ctl_t ctl;
     struct tm now;
@@ -80,27 +103,40 @@ typedef struct {
 display_ctx_t display_ctx;
 
 typedef struct {
-    double increment;
-    double limit;
+    temp_t increment;
+    temp_t limit;
 
-    double *pgoal_temperature;
+    temp_t *pgoal_temperature;
 } deb_ctx_t;
 
+/* heater control */
+control_hysteresis_t heater_hysteresis;
+control_pid_t heater_pid;
+control_law_t heater_law;
+control_relay_t heater_relay;
+
 /* debouncer contexts */
 deb_ctx_t increment_ctx;
 deb_ctx_t decrement_ctx;
 
+/* deferred display updates (see Events.h) */
+event_source_t display_source;
+
 /* -- static function prototypes -------------------------------------------- */
 
 /* timed action callbacks  */
-static int display_callback(timer_id_t unused, ticks_t now, void *ctx);
+static void display_callback(long unused, int code, void *ctx);
 static int sampling_callback(timer_id_t unused, ticks_t now, void *ctx);
 static int thermal_callback(timer_id_t unused, ticks_t now, void *ctx);
 static int clock_callback(timer_id_t unused, ticks_t now, void *ctx);
+#ifdef USE_SLCD
+static int slcd_callback(timer_id_t unused, ticks_t now, void *ctx);
+#endif
 
-/* button callbacks */
+/* button callbacks; the setpoint buttons share their pins with the clock
+   buttons, enable them in setup() when wired elsewhere */
 static int thermal_button_callback(deb_id_t unused, debouncer_state_t state,
-                                   void *ctx);
+                                   void *ctx) __attribute__((unused));
 
 static int clk_switch_callback(deb_id_t unused, debouncer_state_t state,
                                void *ctx);
@@ -109,90 +145,127 @@ static int clk_adjust_callback(deb_id_t unused, debouncer_state_t state,
                                void *ctx);
 
 
-/* command function, with actuates to the outer world. */
-static int control(int status);
-
 /* LCD helpers */
 static void update_display(display_ctx_t *pctx);
-
-/* misc */
-static double readTemp();
-static void SLCDprintFloat(double number, uint8_t digits);
+static void format_2d(char *p, int n, int show);
+static void print_temp(temp_t t);
+#ifdef USE_SLCD
+static void slcd_flush();
+#endif
 
 /** -- implementation ------------------------------------------------------- */
 void setup()
 {
     int rc;
+    timer_id_t tid;
 
     // pinMode(di_increment, INPUT);
     // pinMode(di_decrement, INPUT);
     pinMode(di_clk_adjust, INPUT);
     pinMode(di_clk_switch, INPUT);
-    pinMode(do_actuate, OUTPUT);
 
     debug_init();
 
 #ifdef USE_SLCD
     slcd.begin();
+
+    /* draw into the shadow framebuffer, send only what changes */
+    slcd.buffer();
 #else
     Serial.begin(9600); /* debug only */
 #endif
 
     /* -- data initialization ----------------------------------------------- */
     memset( &display_ctx, 0, sizeof(display_ctx_t));
-    display_ctx.hyst_offset = .2 ;
-    display_ctx.hyst_status = H_LOW;
-    display_ctx.goal_temperature = 25.0;
+    display_ctx.samples.init();
+    display_ctx.goal_temperature = 2500;
     display_ctx.ctl = CTL_RUNNING;
 
     memset( &increment_ctx, 0, sizeof(deb_ctx_t));
-    increment_ctx.increment = .5;
-    increment_ctx.limit = 40.0;
+    increment_ctx.increment = 50;
+    increment_ctx.limit = 4000;
     increment_ctx.pgoal_temperature = &display_ctx.goal_temperature;
 
     memset( &decrement_ctx, 0, sizeof(deb_ctx_t));
-    decrement_ctx.increment = - .5;
-    decrement_ctx.limit = 0.0;
+    decrement_ctx.increment = - 50;
+    decrement_ctx.limit = 0;
     decrement_ctx.pgoal_temperature = &display_ctx.goal_temperature;
 
+    /* -- heater control ---------------------------------------------------- */
+#ifdef USE_PID
+    control_pid_init(&heater_pid, PID_KP, PID_KI, PID_KD);
+    heater_law.update = control_pid;
+    heater_law.state = &heater_pid;
+#else
+    control_hysteresis_init(&heater_hysteresis, HYST_OFFSET);
+    heater_law.update = control_hysteresis;
+    heater_law.state = &heater_hysteresis;
+#endif
+
+    control_relay_init(&heater_relay, do_actuate, RELAY_WINDOW,
+                       RELAY_MIN_ON, RELAY_MIN_OFF);
+
     /* -- timers ------------------------------------------------------------ */
     rc = timers_init();
     if (0 != rc) HALT();
 
-    rc = timers_schedule(TEMP_SAMPLE_PERIOD, sampling_callback, &display_ctx);
-    if (0 > rc) HALT();
+    rc = events_init();
+    if (0 != rc) HALT();
 
-    rc = timers_schedule(LCD_UPDATE_PERIOD, display_callback, &display_ctx);
-    if (0 > rc) HALT();
+    tid = timers_schedule(TEMP_SAMPLE_PERIOD, sampling_callback, &display_ctx);
+    if (0 > tid) HALT();
 
-    rc = timers_schedule(ACT_UPDATE_PERIOD, thermal_callback, &display_ctx);
-    if (0 > rc) HALT();
+    /* the display takes a while to format, run it after everything else */
+    display_source.handler = display_callback;
+    display_source.ctx = &display_ctx;
+    display_source.prio = EVENT_PRIO_LOW;
+    display_source.periodic = 1;
 
-    rc = timers_schedule(CLK_PERIOD, clock_callback, &display_ctx);
-    if (0 > rc) HALT();
+    tid = timers_schedule(LCD_UPDATE_PERIOD, events_timer_post,
+                          &display_source);
+    if (0 > tid) HALT();
+
+    tid = timers_schedule(ACT_UPDATE_PERIOD, thermal_callback, &display_ctx);
+    if (0 > tid) HALT();
+
+    tid = timers_schedule(CLK_PERIOD, clock_callback, &display_ctx);
+    if (0 > tid) HALT();
+
+#ifdef USE_SLCD
+    /* whatever begin() left in the queue */
+    slcd_flush();
+#endif
 
     /* -- debouncers  ------------------------------------------------------- */
     rc = debouncers_init();
     if (0 != rc) HALT();
 
     // rc = debouncers_enable( thermal_button_callback, di_increment,
-    // &increment_ctx);
+    // &increment_ctx, &adjust_timing);
     // if (0 > rc) HALT();
 
     // rc = debouncers_enable( thermal_button_callback, di_decrement,
-    // &decrement_ctx);
+    // &decrement_ctx, &adjust_timing);
     // if (0 > rc) HALT();
 
     rc = debouncers_enable( clk_switch_callback, di_clk_switch, &display_ctx);
     if (0 > rc) HALT();
 
-    rc = debouncers_enable( clk_adjust_callback, di_clk_adjust, &display_ctx);
+    rc = debouncers_enable( clk_adjust_callback, di_clk_adjust, &display_ctx,
+                            &adjust_timing);
     if (0 > rc) HALT();
 }
 
 void loop()
 {
     timers_check();
+    debouncers_check();
+
+    /* deferred handlers */
+    events_dispatch();
+
+    /* sleep until the next timer is due, or a button is pressed */
+    timers_idle();
 }
 
 /* -- static functions ------------------------------------------------------ */
@@ -200,7 +273,11 @@ static int thermal_button_callback(deb_id_t unused, debouncer_state_t state,
                                    void *ctx)
 {
     deb_ctx_t *pctx = (deb_ctx_t *) ctx;
-    double tmp = *(pctx->pgoal_temperature) + pctx->increment;
+    temp_t tmp = temp_add(*(pctx->pgoal_temperature), pctx->increment);
+
+    /* one step per click, and per auto-repeat */
+    if (DEB_CLICK != state && DEB_HOLD != state)
+        return 0;
 
     if (0 < pctx->increment) {
         /* raising, still within acceptable limits */
@@ -225,6 +302,9 @@ static int clk_switch_callback(deb_id_t unused, debouncer_state_t state,
 {
     display_ctx_t *pctx = (display_ctx_t *) ctx;
 
+    if (DEB_CLICK != state)
+        return 0;
+
     switch (pctx->ctl) {
     case CTL_RUNNING:
         pctx->ctl = CTL_SET_HOUR;
@@ -249,6 +329,10 @@ static int clk_adjust_callback(deb_id_t unused, debouncer_state_t state,
 {
     display_ctx_t *pctx = (display_ctx_t *) ctx;
 
+    /* one step per click, and per auto-repeat */
+    if (DEB_CLICK != state && DEB_HOLD != state)
+        return 0;
+
     switch (pctx->ctl) {
     case CTL_RUNNING:
         /* nop */
@@ -273,7 +357,7 @@ static int clk_adjust_callback(deb_id_t unused, debouncer_state_t state,
 }
 
 
-static int display_callback(timer_id_t unused, ticks_t now, void *ctx)
+static void display_callback(long unused, int code, void *ctx)
 {
 #ifdef USE_SLCD
     display_ctx_t *pctx = (display_ctx_t *) ctx;
@@ -309,9 +393,10 @@ static int display_callback(timer_id_t unused, ticks_t now, void *ctx)
 
         update_display(pctx);
     }
-#endif
 
-    return 1; /* infinite rescheduling */
+    slcd.refresh();
+    slcd_flush();
+#endif
 }
 
 static int thermal_callback(timer_id_t unused, ticks_t now, void *ctx)
@@ -319,22 +404,10 @@ static int thermal_callback(timer_id_t unused, ticks_t now, void *ctx)
     display_ctx_t *pctx = (display_ctx_t *) ctx;
     if (! pctx->initialized) return 1;
 
-    /* turn on/off? */
-    if (H_LOW == pctx->hyst_status) {
-        double thr = pctx->goal_temperature - pctx->hyst_offset;
-        if (pctx->curr_temperature < thr) {
-            pctx->hyst_status = H_HIGH;
-            control(1);
-        }
-    }
-    else if (H_HIGH == pctx->hyst_status) {
-        double thr = pctx->goal_temperature + pctx->hyst_offset;
-        if (thr < pctx->curr_temperature) {
-            pctx->hyst_status = H_LOW;
-            control(0);
-        }
-    }
-    else HALT();
+    int duty = control_update(&heater_law, pctx->curr_temperature,
+                              pctx->goal_temperature);
+
+    control_relay_update(&heater_relay, now, duty);
 
     return 1; /* infinite rescheduling */
 }
@@ -343,25 +416,27 @@ static int sampling_callback(timer_id_t unused, ticks_t now, void *ctx)
 {
     display_ctx_t *pctx = (display_ctx_t *) ctx;
 
-    /* read a sample into ring buffer */
-    pctx->samples[pctx->last_sample ++] = readTemp();
-    if (N_SAMPLES == pctx->last_sample) {
+    /* average raw readings, only the average is converted */
+    pctx->samples.add(analogRead(ai_thermistor));
+    if (pctx->samples.is_full()) {
         pctx->initialized = 1;
-        pctx->last_sample = 0;
+        pctx->curr_temperature = thermistor_centi(
+            thermistor_adc(pctx->samples.sum(), N_SAMPLES));
     }
 
-    if (pctx->initialized) {
-        double sum = .0;
-        int i = 0;
+    return 1; /* infinite rescheduling */
+}
 
-        for (i = 0; i < N_SAMPLES; ++ i) {
-            sum += pctx->samples[i];
-        }
-        pctx->curr_temperature = sum / N_SAMPLES;
-    }
+#ifdef USE_SLCD
+static int slcd_callback(timer_id_t unused, ticks_t now, void *ctx)
+{
+    SerialLCD *lcd = (SerialLCD *) ctx;
 
-    return 1; /* infinite rescheduling */
+    /* stops once the queue is empty, see slcd_flush */
+    slcd_polling = lcd->poll();
+    return slcd_polling;
 }
+#endif
 
 static int clock_callback(timer_id_t unused, ticks_t now, void *ctx)
 {
@@ -388,98 +463,55 @@ static int clock_callback(timer_id_t unused, ticks_t now, void *ctx)
 static void update_display(display_ctx_t *pctx)
 {
 #ifdef USE_SLCD
-    char buf[20];
+    char buf[6];
 
     GOTO_XY(0, 0);
-    SLCDprintFloat(pctx->curr_temperature, 1);
+    print_temp(pctx->curr_temperature);
 
     GOTO_XY(0, 1);
-    SLCDprintFloat(pctx->goal_temperature, 1);
+    print_temp(pctx->goal_temperature);
 
+    /* hh:mm, the separator blinks while running, the field being
+       adjusted blinks otherwise */
     GOTO_XY(11, 1);
     pctx->heartbeat = ! pctx->heartbeat;
-    if (CTL_RUNNING == pctx->ctl) {
-        snprintf(buf, 10, "%02d%c%02d",
-                 pctx->now.tm_hour,
-                 pctx->heartbeat ? ':' : ' ',
-                 pctx->now.tm_min);
-    }
-    else if (CTL_SET_HOUR == pctx->ctl) {
-        if (pctx->heartbeat) {
-            snprintf(buf, 10, "%02d:%02d",
-                     pctx->now.tm_hour, pctx->now.tm_min);
-        }
-        else {
-            snprintf(buf, 10, "  :%02d", pctx->now.tm_min);
-        }
-    }
-    else if (CTL_SET_MINUTE == pctx->ctl) {
-        if (pctx->heartbeat) {
-            snprintf(buf, 10, "%02d:%02d",
-                     pctx->now.tm_hour, pctx->now.tm_min);
-        }
-        else {
-            snprintf(buf, 10, "%02d:  ", pctx->now.tm_hour);
-        }
-    }
+
+    format_2d(buf, pctx->now.tm_hour,
+              CTL_SET_HOUR != pctx->ctl || pctx->heartbeat);
+    buf[2] = (CTL_RUNNING != pctx->ctl || pctx->heartbeat) ? ':' : ' ';
+    format_2d(buf + 3, pctx->now.tm_min,
+              CTL_SET_MINUTE != pctx->ctl || pctx->heartbeat);
+    buf[5] = '\0';
 
     slcd.print(buf);
 #endif
 }
 
-static inline int control(int status)
-{
-    digitalWrite( do_actuate, status ? HIGH : LOW );
-    return 0;
-}
-
 /* -- helpers --------------------------------------------------------------- */
 #ifdef USE_SLCD
-static void SLCDprintFloat(double number, uint8_t digits)
+/* prints t with one decimal, rounded half away from zero */
+static void print_temp(temp_t t)
 {
-    // Handle negative numbers
-    if (number < 0.0) {
-        slcd.print('-');
-        number = -number;
-    }
-
-    // Round correctly so that slcd.print(1.999, 2) prints as "2.00"
-    double rounding = 0.5;
-    for (uint8_t i=0; i<digits; ++i) {
-        rounding /= 10.0;
-    }
-
-    number += rounding;
-
-    // Extract the integer part of the number and print it
-    unsigned long int_part = (unsigned long)number;
-    float remainder = number - (float)int_part;
-    slcd.print(int_part , DEC); // base DEC
+    slcd.printFixed(((long) t + (t < 0 ? -5 : 5)) / 10, 1);
+}
 
-    // Print the decimal point, but only if there are digits beyond
-    if (digits > 0) {
-        slcd.print(".");
-    }
+/* sends what was queued for the LCD, and arms the poll timer for the
+   rest unless it is active already */
+static void slcd_flush()
+{
+    if (slcd_polling || ! slcd.poll())
+        return;
 
-    // Extract digits from the remainder one at a time
-    while (digits-- > 0) {
-        remainder *= 10.0;
-        float toPrint = float(remainder);
-        slcd.print(toPrint , DEC);//base DEC
-        remainder -= toPrint;
-    }
+    slcd_polling = (0 <= timers_schedule(LCD_POLL_PERIOD, slcd_callback,
+                                         &slcd));
 }
 #endif
 
-static double readTemp()
+/* writes n on two digits at p, or two blanks if not shown */
+static void format_2d(char *p, int n, int show)
 {
-    const int B=3975;
-    double res, sensor;
-    int sensorValue = analogRead( ai_thermistor );
-
-    sensor=(double)( 1023 - sensorValue ) * 10000 / sensorValue;
-    res =1 / (log( sensor / 10000 ) / B + 1 / 298.15 ) - 273.15;
-    return res;
+    p[0] = show ? '0' + n / 10 : ' ';
+    p[1] = show ? '0' + n % 10 : ' ';
 }
 
 /* a dummy comment for a demo... */
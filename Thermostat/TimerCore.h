@@ -0,0 +1 @@
+../TimerCore/TimerCore.h
\ No newline at end of file
@@ -0,0 +1 @@
+../TimerCore/TimerHeap.h
\ No newline at end of file
@@ -0,0 +1 @@
+../TimerCore/TimerQueue.h
\ No newline at end of file
@@ -0,0 +1 @@
+../TimerCore/TimerStats.h
\ No newline at end of file
@@ -0,0 +1 @@
+../TimerCore/TimerWheel.h
\ No newline at end of file
@@ -0,0 +1 @@
+../Debouncers/VerticalDebouncerBank.h
\ No newline at end of file
@@ -0,0 +1,159 @@
+/**
+ * @file TimerCore.h
+ * @brief Timer core shared by the Timers and Microtimers libraries
+ *
+ * Copyright (C) 2013 Marco Pensallorto
+ * < marco DOT pensallorto AT gmail DOT com >
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+**/
+#ifndef TIMER_CORE_H_DEFINED
+#define TIMER_CORE_H_DEFINED
+
+#include <Arduino.h>
+
+/* The timer engines (see TimerHeap.h and TimerWheel.h) are templates
+   parameterized on a tick source. A tick source is any type providing
+   a ticks_t unsigned typedef and a static now() function; ticks_t sets
+   the tick width. Host builds can plug in a fake clock to exercise the
+   wrap point. */
+
+/* -- custom typedefs ------------------------------------------------------- */
+
+/* Timer ids carry the slot index in their lowest TIMER_CORE_ID_SLOT_BITS
+   bits and the 16 bits generation count of that slot above them. Lookup
+   is a direct index and ids of expired or cancelled timers are rejected,
+   until the generation of that slot wraps around. */
+typedef long timer_core_id_t;
+const int TIMER_CORE_ID_SLOT_BITS = 8;
+
+/* slots are linked by 8-bit indexes, this one stands for none */
+const unsigned char TIMER_CORE_NIL = 0xFF;
+const int TIMER_CORE_MAX_SLOTS = TIMER_CORE_NIL;
+
+/* Periodic timers are rescheduled from their ideal deadline, never from
+   the time their handler actually ran. When the loop falls behind by
+   one or more periods, the catch-up policy decides what happens to the
+   missed ones. */
+typedef enum {
+    /** fire once per missed period, back to back */
+    TIMER_CATCHUP_BURST,
+
+    /** drop missed periods, stay on the original period grid */
+    TIMER_CATCHUP_SKIP,
+
+    /** drop missed periods, restart the period grid from now */
+    TIMER_CATCHUP_COALESCE,
+} timer_catchup_t;
+
+/* Dispatch overrun counters. A pass of check() stops when it runs out of
+   budget (see set_budget) with expired timers still waiting: those are
+   deferred to the next pass, where they run ahead of everything else. */
+typedef struct {
+
+    /** passes cut short with expired timers still waiting */
+    unsigned long overruns;
+
+    /** expirations deferred to a later pass */
+    unsigned long deferred;
+
+    /** worst lateness of a deferred expiration when it finally ran (ticks) */
+    unsigned long deferred_lateness;
+} timer_overrun_t;
+
+/* -- tick sources ---------------------------------------------------------- */
+struct MillisClock {
+    typedef unsigned long ticks_t;
+    static ticks_t now() { return millis(); }
+};
+
+struct MicrosClock {
+    typedef unsigned long ticks_t;
+    static ticks_t now() { return micros(); }
+};
+
+/* -- helpers --------------------------------------------------------------- */
+
+/* Deadlines are compared by the sign of their difference, which stays
+   correct across clock overflow as long as the compared instants are
+   less than half the ticks_t range apart. Delays must stay below that
+   bound (about 24 days for millis(), 35 minutes for micros()). */
+template <typename T>
+inline int timer_core_before(T a, T b)
+{
+    return (T)(a - b) > (T)((T) ~(T) 0 >> 1);
+}
+
+/* returns the deadline following a periodic expiration at deadline */
+template <typename T>
+inline T timer_core_next_deadline(T deadline, T dly, T now,
+                                  timer_catchup_t catchup)
+{
+    T next = deadline + dly;
+
+    /* on time, or nothing to catch up with */
+    if (TIMER_CATCHUP_BURST == catchup || 0 == dly ||
+        timer_core_before(now, next))
+        return next;
+
+    if (TIMER_CATCHUP_SKIP == catchup)
+        return next + (T)(now - next) / dly * dly + dly;
+
+    return now + dly; /* TIMER_CATCHUP_COALESCE */
+}
+
+/* returns the id of slot index at generation gen */
+inline timer_core_id_t timer_core_id(unsigned short gen, unsigned char index)
+{
+    return ((long) gen << TIMER_CORE_ID_SLOT_BITS) | index;
+}
+
+/* returns the generation encoded in id */
+inline unsigned short timer_core_gen(timer_core_id_t id)
+{
+    return (unsigned short) (id >> TIMER_CORE_ID_SLOT_BITS);
+}
+
+/* returns the slot index encoded in id, -1 if out of range */
+inline int timer_core_index(timer_core_id_t id, int max_slots)
+{
+    long index = id & ((1L << TIMER_CORE_ID_SLOT_BITS) - 1);
+
+    return (0 <= id && 0 == (id >> (TIMER_CORE_ID_SLOT_BITS + 16)) &&
+            index < max_slots)
+        ? (int) index : -1;
+}
+
+/* returns lateness saturated to the width of a slot jitter field */
+template <typename T>
+inline unsigned short timer_core_saturate(T lateness)
+{
+    return (lateness < (T) 0xFFFF)
+        ? (unsigned short) lateness : 0xFFFF;
+}
+
+/* largest size allowed for the packed slot of an engine: two ticks_t,
+   two pointers and 8 bytes of indexes and flags, plus the padding up to
+   pointer alignment a narrow ticks_t gets on wider targets */
+#define TIMER_CORE_SLOT_BOUND(ticks_t)                                  \
+    ((2 * sizeof(ticks_t) + 3 * sizeof(void *) + 7) /                   \
+     sizeof(void *) * sizeof(void *))
+
+/* compile-time assertion, fails to build if cond is false */
+#define TIMER_CORE_STATIC_ASSERT(cond, name)                            \
+    typedef char name[(cond) ? 1 : -1] __attribute__((unused))
+
+#endif
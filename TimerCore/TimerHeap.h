@@ -0,0 +1,546 @@
+/**
+ * @file TimerHeap.h
+ * @brief Binary heap timer engine
+ *
+ * Copyright (C) 2013 Marco Pensallorto
+ * < marco DOT pensallorto AT gmail DOT com >
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+**/
+#ifndef TIMER_HEAP_H_DEFINED
+#define TIMER_HEAP_H_DEFINED
+
+#include <TimerCore.h>
+#include <TimerStats.h>
+#include <Debug.h>
+
+#include <string.h>
+
+/* Active timers are kept in a binary min-heap, earliest deadline on
+   top. Each timer knows its own heap position, so schedule, periodic
+   reschedule and removal are O(log n) and lookup by id is O(1).
+
+   A timer fires at most once per pass of check(): a periodic timer
+   still due after firing is parked off the heap until the pass is over.
+   Timers left waiting when a pass runs out of budget are flagged as
+   deferred and sort ahead of all the others, so that a long or lagging
+   periodic handler cannot starve the rest of a burst.
+
+   Slots and the heap refer to each other by 8-bit indexes, hence N may
+   not exceed TIMER_CORE_MAX_SLOTS. */
+template <class Clock, int N, class Stats = TimerNoStats>
+class TimerHeap : private Stats {
+public:
+    typedef typename Clock::ticks_t ticks_t;
+    typedef int handler_t(timer_core_id_t id, ticks_t now, void *ctx);
+
+    /** returns true if engine is initialized, false otherwise */
+    int is_initialized()
+    { return _initialized; }
+
+    /** initializes the engine. Must be invoked once, before using it.
+        A max_simultaneous_timeouts of 0 fires every due timer per pass */
+    int init(int max_simultaneous_timeouts, timer_catchup_t catchup)
+    {
+        int i = N - 1;
+
+        TIMER_CORE_STATIC_ASSERT(0 < N && N <= TIMER_CORE_MAX_SLOTS,
+                                 timer_heap_too_many_slots);
+
+        /* the slot layout is packed by hand, don't let it grow */
+        TIMER_CORE_STATIC_ASSERT(sizeof(slot_t) <=
+                                 TIMER_CORE_SLOT_BOUND(ticks_t),
+                                 timer_heap_slot_grew);
+
+        _free_list = _parked = TIMER_CORE_NIL;
+        _heap_size = 0;
+
+        while (0 <= i) {
+            memset(_array + i, 0, sizeof(slot_t));
+            _array[i].heap_pos = TIMER_CORE_NIL;
+            _array[i].next = _free_list;
+            _free_list = i;
+            -- i;
+        }
+
+        _max_timeouts = max_simultaneous_timeouts;
+        _catchup = catchup;
+        _budget = 0;
+
+        memset(&_overrun, 0, sizeof(_overrun));
+        Stats::stats_reset();
+        _pass = 0;
+        _initialized = 1;
+
+        return 0;
+    }
+
+    /** schedules a delayed action. returns timer id, -1 on failure */
+    timer_core_id_t schedule(ticks_t dly, handler_t handler, void *user_data)
+    {
+        ASSERT(is_initialized());
+
+        unsigned char index = array_insert();
+        if (TIMER_CORE_NIL == index)
+            return -1;
+
+        /* populate data structure */
+        slot_t *elem = &_array[index];
+        elem->deadline = Clock::now() + dly;
+        elem->dly = dly;
+        elem->jitter = 0;
+        elem->pass = 0;
+        elem->deferred = 0;
+        elem->parked = 0;
+        elem->handler = handler;
+        elem->user_data = user_data;
+
+        heap_place(index, _heap_size ++);
+        heap_sift_up(elem->heap_pos);
+
+        timer_core_id_t id = timer_core_id(elem->gen, index);
+        Stats::stats_clear(index, id);
+
+        return id;
+    }
+
+    /** returns number of ticks before expiration, 0 if already expired,
+        all ones if not found */
+    ticks_t timeleft(timer_core_id_t id)
+    {
+        ASSERT(is_initialized());
+
+        slot_t *timer = lookup(id);
+        if (NULL == timer)
+            return (ticks_t) ~(ticks_t) 0; /* not found */
+
+        ticks_t now = Clock::now();
+        return timer_core_before(now, timer->deadline)
+            ? timer->deadline - now
+            : 0;
+    }
+
+    /** returns number of ticks before the earliest expiration, 0 if a
+        timer is already due, all ones if no timer is active */
+    ticks_t next_deadline()
+    {
+        ASSERT(is_initialized());
+
+        /* parked timers are due, see check() */
+        if (TIMER_CORE_NIL != _parked)
+            return 0;
+
+        if (0 == _heap_size)
+            return (ticks_t) ~(ticks_t) 0; /* nothing scheduled */
+
+        ticks_t now = Clock::now();
+        ticks_t deadline = _array[_heap[0]].deadline;
+        return timer_core_before(now, deadline)
+            ? deadline - now
+            : 0;
+    }
+
+    /** returns the worst lateness seen so far for a timer, saturated to
+        0xFFFF ticks; all ones if not found */
+    ticks_t jitter(timer_core_id_t id)
+    {
+        ASSERT(is_initialized());
+
+        slot_t *timer = lookup(id);
+        return (NULL != timer)
+            ? timer->jitter : (ticks_t) ~(ticks_t) 0;
+    }
+
+    /** cancels an existing timer. Returns 0 if succesful, -1 otherwise */
+    int cancel(timer_core_id_t id)
+    {
+        ASSERT(is_initialized());
+
+        slot_t *timer = lookup(id);
+        if (NULL == timer)
+            return -1; /* not found */
+
+        array_remove(timer - _array);
+        return 0;
+    }
+
+    /** sets a time budget for each check() pass, in microseconds. While
+        non zero, handlers keep firing until the budget is spent instead
+        of up to max_simultaneous_timeouts per pass. At least one handler
+        runs per pass. */
+    void set_budget(unsigned long usecs)
+    { _budget = usecs; }
+
+    /** fills stats with the dispatch overrun counters */
+    void overrun(timer_overrun_t *stats)
+    { *stats = _overrun; }
+
+    /** fills stats with the figures of a timer (see TimerStats.h),
+        active or expired as long as its slot was not reused. Returns 0
+        if succesful, -1 if not found, if it never fired or if statistics
+        are disabled */
+    int stats(timer_core_id_t id, timer_stats_t *stats)
+    {
+        ASSERT(is_initialized());
+
+        slot_t *timer = lookup_slot(id);
+        if (NULL == timer)
+            return -1; /* not found */
+
+        return Stats::stats_get(timer - _array, stats);
+    }
+
+    /** fills trace with the i-th most recent fire, 0 being the latest.
+        Returns 0 if succesful, -1 otherwise */
+    int trace(int i, timer_trace_t *trace)
+    { return Stats::stats_trace(i, trace); }
+
+    /** prints statistics and trace to out, nothing if disabled */
+    void dump_stats(Print &out)
+    { Stats::stats_dump(out); }
+
+    /** fires expired timers, to be invoked by main loop() */
+    void check()
+    {
+        int count = 0;
+        ASSERT(is_initialized());
+
+        unsigned long start = micros();
+        ticks_t now = Clock::now();
+
+        next_pass();
+        while (0 < _heap_size) {
+            unsigned char index = _heap[0];
+            slot_t *head = &_array[index];
+            if (timer_core_before(now, head->deadline))
+                break;
+
+            /* already fired in this pass and due again, it waits for
+               the next one without holding up the others */
+            if (head->pass == _pass) {
+                park(index);
+                continue;
+            }
+
+            /* out of budget: whatever is still due waits for the next
+               pass */
+            if (out_of_budget(start, count)) {
+                defer(now);
+                break;
+            }
+
+            /* lateness is sampled right before the handler runs, so
+               timers fired later in the same pass account for it */
+            ticks_t fired = Clock::now();
+            ticks_t lateness = fired - head->deadline;
+            unsigned short jitter = timer_core_saturate(lateness);
+            if (head->jitter < jitter)
+                head->jitter = jitter;
+
+            if (head->deferred &&
+                _overrun.deferred_lateness < lateness)
+                _overrun.deferred_lateness = lateness;
+
+            head->pass = _pass;
+
+            unsigned short gen = head->gen;
+            timer_core_id_t id = timer_core_id(gen, index);
+            Stats::stats_begin();
+            int again = head->handler(id, fired, head->user_data);
+            Stats::stats_end(index, id, fired, lateness);
+
+            if (! again) {
+                /* the handler may have cancelled the timer already */
+                if (gen == head->gen && TIMER_CORE_NIL != head->heap_pos)
+                    array_remove(index);
+            }
+            else if (gen == head->gen && TIMER_CORE_NIL != head->heap_pos) {
+                /* reschedule, the new deadline is later: push it down */
+                head->deferred = 0;
+                head->deadline = timer_core_next_deadline(head->deadline,
+                                                          head->dly, fired,
+                                                          _catchup);
+                heap_sift_down(head->heap_pos);
+            }
+
+            ++ count;
+        } /* while */
+
+        unpark();
+    }
+
+private:
+    typedef struct {
+
+        /** absolute expiration time */
+        ticks_t deadline;
+
+        /** delay (ticks), also the rescheduling period */
+        ticks_t dly;
+
+        /** Scheduled time action */
+        handler_t *handler;
+
+        /** Reserved for the user */
+        void *user_data;
+
+        /** generation count, bumped on every allocation (see ids) */
+        unsigned short gen;
+
+        /** worst lateness seen so far (ticks, saturated) */
+        unsigned short jitter;
+
+        /** position in the active heap, NIL if not active or parked */
+        unsigned char heap_pos;
+
+        /** free list link */
+        unsigned char next;
+
+        /** last pass this timer fired in, 0 if none (see next_pass) */
+        unsigned char pass;
+
+        /** left waiting by the last pass, sorts first */
+        unsigned char deferred : 1;
+
+        /** off the heap until the end of the current pass (see park) */
+        unsigned char parked : 1;
+    } slot_t;
+
+    /* configurable parameters (see init) */
+    int _max_timeouts;
+    timer_catchup_t _catchup;
+    unsigned long _budget;
+
+    slot_t _array[N];
+    unsigned char _free_list;
+
+    unsigned char _heap[N];
+    unsigned char _heap_size;
+
+    /* timers parked by the current pass, linked through next */
+    unsigned char _parked;
+
+    timer_overrun_t _overrun;
+    unsigned char _pass;
+
+    int _initialized;
+
+    /* starts a new pass. Pass 0 is never used: when the counter wraps
+       every tag is cleared, so no stale tag ever matches the current pass */
+    void next_pass()
+    {
+        int i;
+
+        if (0 == ++ _pass) {
+            for (i = 0; i < N; ++ i)
+                _array[i].pass = 0;
+
+            _pass = 1;
+        }
+    }
+
+    /* returns true if the current pass may not fire any more handlers */
+    int out_of_budget(unsigned long start, int count)
+    {
+        return (0 < _budget)
+            ? (0 < count && _budget <= micros() - start)
+            : (0 < _max_timeouts && _max_timeouts <= count);
+    }
+
+    /* flags all expired timers that did not fire in this pass as
+       deferred, they move ahead of the others */
+    void defer(ticks_t now)
+    {
+        int i;
+
+        ++ _overrun.overruns;
+        for (i = 0; i < N; ++ i) {
+            slot_t *timer = &_array[i];
+
+            if (TIMER_CORE_NIL == timer->heap_pos || timer->deferred ||
+                timer->pass == _pass ||
+                timer_core_before(now, timer->deadline))
+                continue;
+
+            timer->deferred = 1;
+            ++ _overrun.deferred;
+            heap_sift_up(timer->heap_pos);
+        }
+    }
+
+    /* takes a timer that already fired in this pass off the heap, until
+       the pass is over */
+    void park(unsigned char index)
+    {
+        slot_t *timer = &_array[index];
+
+        heap_remove(index);
+        timer->parked = 1;
+        timer->next = _parked;
+        _parked = index;
+    }
+
+    /* puts the parked timers back on the heap */
+    void unpark()
+    {
+        while (TIMER_CORE_NIL != _parked) {
+            unsigned char index = _parked;
+            slot_t *timer = &_array[index];
+
+            _parked = timer->next;
+            timer->next = TIMER_CORE_NIL;
+            timer->parked = 0;
+
+            heap_place(index, _heap_size ++);
+            heap_sift_up(timer->heap_pos);
+        }
+    }
+
+    /* returns the slot last allocated to the timer with given id, active
+       or not, NULL if not found or reused since */
+    slot_t *lookup_slot(timer_core_id_t id)
+    {
+        int index = timer_core_index(id, N);
+        if (index < 0)
+            return NULL;
+
+        slot_t *timer = &_array[index];
+        return (timer->gen == timer_core_gen(id)) ? timer : NULL;
+    }
+
+    /* returns the active timer with given id, NULL if not found */
+    slot_t *lookup(timer_core_id_t id)
+    {
+        slot_t *timer = lookup_slot(id);
+        return (NULL != timer && (TIMER_CORE_NIL != timer->heap_pos || timer->parked))
+            ? timer : NULL;
+    }
+
+    /* fetches a slot from the free list, NIL if none is left */
+    unsigned char array_insert()
+    {
+        unsigned char index = _free_list;
+        if (TIMER_CORE_NIL == index)
+            return TIMER_CORE_NIL;
+
+        /* fetch head from free list, the slot moves one generation on */
+        _free_list = _array[index].next;
+
+        ++ _array[index].gen;
+        _array[index].next = TIMER_CORE_NIL;
+
+        return index;
+    }
+
+    void array_remove(unsigned char index)
+    {
+        slot_t *timer = &_array[index];
+
+        if (timer->parked) {
+            /* unlink from the parked list, a few entries at most */
+            unsigned char *link = &_parked;
+            while (*link != index)
+                link = &_array[*link].next;
+
+            *link = timer->next;
+            timer->parked = 0;
+        }
+        else
+            heap_remove(index);
+
+        /* put block back into free list */
+        timer->next = _free_list;
+        _free_list = index;
+    }
+
+    /* takes a timer off the heap */
+    void heap_remove(unsigned char index)
+    {
+        slot_t *timer = &_array[index];
+        unsigned char pos = timer->heap_pos;
+        ASSERT(pos < _heap_size && _heap[pos] == index);
+
+        /* fill the hole with the last element, then restore heap order */
+        unsigned char last = _heap[ -- _heap_size ];
+        if (last != index) {
+            heap_place(last, pos);
+            heap_sift_up(pos);
+            heap_sift_down(_array[last].heap_pos);
+        }
+
+        timer->heap_pos = TIMER_CORE_NIL;
+    }
+
+    /* returns true if a comes no later than b: deferred timers first,
+       then by deadline */
+    inline int heap_cmp(unsigned char a, unsigned char b)
+    {
+        slot_t *sa = &_array[a], *sb = &_array[b];
+
+        if (sa->deferred != sb->deferred)
+            return sa->deferred;
+
+        return ! timer_core_before(sb->deadline, sa->deadline);
+    }
+
+    inline void heap_place(unsigned char index, int pos)
+    {
+        _heap[pos] = index;
+        _array[index].heap_pos = pos;
+    }
+
+    void heap_sift_up(int pos)
+    {
+        unsigned char index = _heap[pos];
+
+        while (0 < pos) {
+            int parent = (pos - 1) / 2;
+            if (heap_cmp(_heap[parent], index))
+                break;
+
+            heap_place(_heap[parent], pos);
+            pos = parent;
+        }
+
+        heap_place(index, pos);
+    }
+
+    void heap_sift_down(int pos)
+    {
+        unsigned char index = _heap[pos];
+
+        while (1) {
+            int child = 2 * pos + 1;
+            if (_heap_size <= child)
+                break;
+
+            /* pick the earlier of the two children */
+            if (child + 1 < _heap_size &&
+                ! heap_cmp(_heap[child], _heap[child + 1]))
+                ++ child;
+
+            if (heap_cmp(index, _heap[child]))
+                break;
+
+            heap_place(_heap[child], pos);
+            pos = child;
+        }
+
+        heap_place(index, pos);
+    }
+};
+
+#endif
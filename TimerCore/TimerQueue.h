@@ -0,0 +1,45 @@
+/**
+ * @file TimerQueue.h
+ * @brief Compile-time sized timer queues
+ *
+ * Copyright (C) 2013 Marco Pensallorto
+ * < marco DOT pensallorto AT gmail DOT com >
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+**/
+#ifndef TIMER_QUEUE_H_DEFINED
+#define TIMER_QUEUE_H_DEFINED
+
+#include <TimerCore.h>
+#include <TimerHeap.h>
+
+/* A timer queue holding up to N timers, with storage sized at compile
+   time. The Timers and Microtimers libraries are default instances of
+   it; sketches needing more (or fewer) slots, or a separate queue, can
+   declare their own:
+
+       static TimerQueue<4> blink_timers;
+       static TimerQueue<8, MicrosClock> pwm_timers;
+
+   and call init(), schedule(), cancel() and check() on it. The timing
+   wheel engine (see TimerWheel.h) offers the same interface. Pass
+   TimerStats<N> as Stats to record dispatch statistics (see
+   TimerStats.h). */
+template <int N, class Clock = MillisClock, class Stats = TimerNoStats>
+class TimerQueue : public TimerHeap<Clock, N, Stats> {
+};
+
+#endif
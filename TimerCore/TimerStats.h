@@ -0,0 +1,244 @@
+/**
+ * @file TimerStats.h
+ * @brief Optional dispatch statistics and tracing for the timer engines
+ *
+ * Copyright (C) 2013 Marco Pensallorto
+ * < marco DOT pensallorto AT gmail DOT com >
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+**/
+#ifndef TIMER_STATS_H_DEFINED
+#define TIMER_STATS_H_DEFINED
+
+#include <TimerCore.h>
+
+#include <string.h>
+
+/* The timer engines take a statistics policy as their last template
+   parameter. TimerNoStats, the default, is empty and all of its hooks
+   are empty inlines: engines derive from it, so that it takes neither
+   RAM nor cycles. TimerStats<N, TRACE> records, for every slot, fire
+   count and min/avg/max lateness (ticks) and handler execution time
+   (microseconds), plus the last TRACE fires in a ring buffer. Storage is
+   static: about 24 bytes per slot and 12 per trace entry on AVR.
+
+   Statistics of a slot are reset when it is allocated to a new timer,
+   so the figures of an expired one-shot timer remain available until
+   then. Minimums and maximums saturate at 0xFFFF. */
+
+/* -- custom typedefs ------------------------------------------------------- */
+typedef struct {
+
+    /** number of times the handler ran */
+    unsigned long fires;
+
+    /** lateness of the handler start w.r.t. the deadline (ticks) */
+    unsigned long lateness_min;
+    unsigned long lateness_avg;
+    unsigned long lateness_max;
+
+    /** handler execution time (microseconds) */
+    unsigned long exec_min;
+    unsigned long exec_avg;
+    unsigned long exec_max;
+} timer_stats_t;
+
+typedef struct {
+
+    /** id of the timer that fired */
+    timer_core_id_t id;
+
+    /** time the handler was started (ticks) */
+    unsigned long fired;
+
+    /** lateness (ticks) and execution time (microseconds), saturated */
+    unsigned short lateness;
+    unsigned short exec;
+} timer_trace_t;
+
+/* -- policies -------------------------------------------------------------- */
+class TimerNoStats {
+public:
+    enum { ENABLED = 0 };
+
+    void stats_reset() {}
+    void stats_clear(unsigned char index, timer_core_id_t id) {}
+    void stats_begin() {}
+    void stats_end(unsigned char index, timer_core_id_t id,
+                   unsigned long fired, unsigned long lateness) {}
+
+    int stats_get(unsigned char index, timer_stats_t *stats)
+    { return -1; }
+
+    int stats_trace(int i, timer_trace_t *trace)
+    { return -1; }
+
+    void stats_dump(Print &out) {}
+};
+
+template <int N, int TRACE = 8>
+class TimerStats {
+public:
+    enum { ENABLED = 1 };
+
+    /* resets all figures, invoked by the engine init() */
+    void stats_reset()
+    {
+        memset(_slots, 0, sizeof(_slots));
+        _trace_head = _trace_count = 0;
+    }
+
+    /* resets the figures of a slot allocated to timer id */
+    void stats_clear(unsigned char index, timer_core_id_t id)
+    {
+        memset(_slots + index, 0, sizeof(slot_stats_t));
+        _slots[index].id = id;
+    }
+
+    /* invoked right before a handler runs */
+    void stats_begin()
+    { _start = micros(); }
+
+    /* invoked right after a handler returns */
+    void stats_end(unsigned char index, timer_core_id_t id,
+                   unsigned long fired, unsigned long lateness)
+    {
+        unsigned short exec = timer_core_saturate(micros() - _start);
+        unsigned short late = timer_core_saturate(lateness);
+
+        timer_trace_t *trace = &_trace[_trace_head];
+        trace->id = id;
+        trace->fired = fired;
+        trace->lateness = late;
+        trace->exec = exec;
+
+        _trace_head = (_trace_head + 1) % TRACE;
+        if (_trace_count < TRACE)
+            ++ _trace_count;
+
+        /* the handler may have cancelled its timer, and the slot may
+           have been reused already */
+        slot_stats_t *slot = &_slots[index];
+        if (slot->id != id)
+            return;
+
+        if (0 == slot->fires || late < slot->lateness_min)
+            slot->lateness_min = late;
+        if (slot->lateness_max < late)
+            slot->lateness_max = late;
+
+        if (0 == slot->fires || exec < slot->exec_min)
+            slot->exec_min = exec;
+        if (slot->exec_max < exec)
+            slot->exec_max = exec;
+
+        slot->lateness_sum += late;
+        slot->exec_sum += exec;
+        ++ slot->fires;
+    }
+
+    /* fills stats with the figures of a slot. Returns 0 if succesful, -1
+       if its timer never fired */
+    int stats_get(unsigned char index, timer_stats_t *stats)
+    {
+        slot_stats_t *slot = &_slots[index];
+        if (0 == slot->fires)
+            return -1;
+
+        stats->fires = slot->fires;
+        stats->lateness_min = slot->lateness_min;
+        stats->lateness_avg = slot->lateness_sum / slot->fires;
+        stats->lateness_max = slot->lateness_max;
+        stats->exec_min = slot->exec_min;
+        stats->exec_avg = slot->exec_sum / slot->fires;
+        stats->exec_max = slot->exec_max;
+
+        return 0;
+    }
+
+    /* fills trace with the i-th most recent fire (0 is the latest).
+       Returns 0 if succesful, -1 if not recorded */
+    int stats_trace(int i, timer_trace_t *trace)
+    {
+        if (i < 0 || _trace_count <= i)
+            return -1;
+
+        *trace = _trace[(_trace_head + TRACE - 1 - i) % TRACE];
+        return 0;
+    }
+
+    /* prints figures of all slots that fired, then the trace */
+    void stats_dump(Print &out)
+    {
+        timer_stats_t stats;
+        timer_trace_t trace;
+        int i;
+
+        out.println(F("id fires late(min/avg/max) exec(min/avg/max)"));
+        for (i = 0; i < N; ++ i) {
+            if (0 != stats_get(i, &stats))
+                continue;
+
+            out.print(_slots[i].id); out.print(' ');
+            out.print(stats.fires); out.print(' ');
+            out.print(stats.lateness_min); out.print('/');
+            out.print(stats.lateness_avg); out.print('/');
+            out.print(stats.lateness_max); out.print(' ');
+            out.print(stats.exec_min); out.print('/');
+            out.print(stats.exec_avg); out.print('/');
+            out.println(stats.exec_max);
+        }
+
+        out.println(F("id fired late exec"));
+        for (i = 0; 0 == stats_trace(i, &trace); ++ i) {
+            out.print(trace.id); out.print(' ');
+            out.print(trace.fired); out.print(' ');
+            out.print(trace.lateness); out.print(' ');
+            out.println(trace.exec);
+        }
+    }
+
+private:
+    typedef struct {
+
+        /** id of the timer owning the slot */
+        timer_core_id_t id;
+
+        unsigned long fires;
+
+        /** sums, for the averages */
+        unsigned long lateness_sum;
+        unsigned long exec_sum;
+
+        unsigned short lateness_min;
+        unsigned short lateness_max;
+        unsigned short exec_min;
+        unsigned short exec_max;
+    } slot_stats_t;
+
+    slot_stats_t _slots[N];
+
+    /* ring buffer of the last fires, _trace_head is the next entry to
+       be written */
+    timer_trace_t _trace[TRACE];
+    int _trace_head;
+    int _trace_count;
+
+    /* start of the running handler */
+    unsigned long _start;
+};
+
+#endif
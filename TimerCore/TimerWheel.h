@@ -0,0 +1,592 @@
+/**
+ * @file TimerWheel.h
+ * @brief Hierarchical timing wheel timer engine
+ *
+ * Copyright (C) 2013 Marco Pensallorto
+ * < marco DOT pensallorto AT gmail DOT com >
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+**/
+#ifndef TIMER_WHEEL_H_DEFINED
+#define TIMER_WHEEL_H_DEFINED
+
+#include <TimerCore.h>
+#include <TimerStats.h>
+#include <Debug.h>
+
+#include <string.h>
+
+/* The wheel has WHEEL_LEVELS levels of WHEEL_SIZE buckets each. Level
+   l holds timers expiring less than 2^(WHEEL_BITS * (l + 1)) ticks
+   ahead, so that the top level spans the whole ticks_t range. Every
+   WHEEL_SIZE ticks one bucket of the level above is cascaded down.
+   Buckets are intrusive doubly linked lists, hence schedule, cancel and
+   expiry are O(1). The wheel is advanced one tick at a time, unless
+   check() finds more than N ticks to catch up with: then it jumps
+   straight to the current time and places every timer afresh, in O(N)
+   (see wheel_jump).
+
+   Expired timers wait in a FIFO list. A rescheduled periodic timer goes
+   back on the wheel, so it fires at most once per pass of check(), and
+   timers deferred by a pass that ran out of budget run first in the
+   next one.
+
+   Lists link slots by 8-bit indexes, hence N may not exceed
+   TIMER_CORE_MAX_SLOTS. */
+template <class Clock, int N, class Stats = TimerNoStats>
+class TimerWheel : private Stats {
+public:
+    typedef typename Clock::ticks_t ticks_t;
+    typedef int handler_t(timer_core_id_t id, ticks_t now, void *ctx);
+
+    /** returns true if engine is initialized, false otherwise */
+    int is_initialized()
+    { return _initialized; }
+
+    /** initializes the engine. Must be invoked once, before using it.
+        A max_simultaneous_timeouts of 0 fires every due timer per pass */
+    int init(int max_simultaneous_timeouts, timer_catchup_t catchup)
+    {
+        int i = N - 1;
+
+        TIMER_CORE_STATIC_ASSERT(0 < N && N <= TIMER_CORE_MAX_SLOTS,
+                                 timer_wheel_too_many_slots);
+
+        /* the slot layout is packed by hand, don't let it grow */
+        TIMER_CORE_STATIC_ASSERT(sizeof(slot_t) <=
+                                 TIMER_CORE_SLOT_BOUND(ticks_t),
+                                 timer_wheel_slot_grew);
+
+        _free_list = TIMER_CORE_NIL;
+        _expired_tail = TIMER_CORE_NIL;
+
+        memset(_heads, TIMER_CORE_NIL, sizeof(_heads));
+        _wheel_count = 0;
+        _wheel_time = Clock::now();
+
+        while (0 <= i) {
+            memset(_array + i, 0, sizeof(slot_t));
+            _array[i].bucket = NO_BUCKET;
+            _array[i].next = _free_list;
+            _free_list = i;
+            -- i;
+        }
+
+        _max_timeouts = max_simultaneous_timeouts;
+        _catchup = catchup;
+        _budget = 0;
+
+        memset(&_overrun, 0, sizeof(_overrun));
+        Stats::stats_reset();
+        _initialized = 1;
+
+        return 0;
+    }
+
+    /** schedules a delayed action. returns timer id, -1 on failure */
+    timer_core_id_t schedule(ticks_t dly, handler_t handler, void *user_data)
+    {
+        ASSERT(is_initialized());
+
+        unsigned char index = array_insert();
+        if (TIMER_CORE_NIL == index)
+            return -1;
+
+        /* populate data structure */
+        slot_t *elem = &_array[index];
+        elem->deadline = Clock::now() + dly;
+        elem->dly = dly;
+        elem->jitter = 0;
+        elem->deferred = 0;
+        elem->handler = handler;
+        elem->user_data = user_data;
+
+        /* due already, e.g. a delay of 0: the wheel is past its tick,
+           the next check() fires it, as the heap does */
+        if (timer_core_before(elem->deadline, _wheel_time)) {
+            ++ _wheel_count;
+            link_expired(index);
+        }
+        else {
+            wheel_add(index);
+        }
+
+        timer_core_id_t id = timer_core_id(elem->gen, index);
+        Stats::stats_clear(index, id);
+
+        return id;
+    }
+
+    /** returns number of ticks before expiration, 0 if already expired,
+        all ones if not found */
+    ticks_t timeleft(timer_core_id_t id)
+    {
+        ASSERT(is_initialized());
+
+        slot_t *timer = lookup(id);
+        if (NULL == timer)
+            return (ticks_t) ~(ticks_t) 0; /* not found */
+
+        ticks_t now = Clock::now();
+        return timer_core_before(now, timer->deadline)
+            ? timer->deadline - now
+            : 0;
+    }
+
+    /** returns number of ticks before the earliest expiration, 0 if a
+        timer is already due, all ones if no timer is active. The wheel
+        does not keep its timers sorted, so this is O(n). */
+    ticks_t next_deadline()
+    {
+        ticks_t left = (ticks_t) ~(ticks_t) 0;
+        int i;
+        ASSERT(is_initialized());
+
+        if (TIMER_CORE_NIL != _heads[EXPIRED])
+            return 0;
+
+        ticks_t now = Clock::now();
+        for (i = 0; i < N && 0 < left; ++ i) {
+            slot_t *timer = &_array[i];
+            if (NO_BUCKET == timer->bucket)
+                continue;
+
+            ticks_t dly = timer_core_before(now, timer->deadline)
+                ? timer->deadline - now : 0;
+            if (dly < left)
+                left = dly;
+        }
+
+        return left;
+    }
+
+    /** returns the worst lateness seen so far for a timer, saturated to
+        0xFFFF ticks; all ones if not found */
+    ticks_t jitter(timer_core_id_t id)
+    {
+        ASSERT(is_initialized());
+
+        slot_t *timer = lookup(id);
+        return (NULL != timer)
+            ? timer->jitter : (ticks_t) ~(ticks_t) 0;
+    }
+
+    /** cancels an existing timer. Returns 0 if succesful, -1 otherwise */
+    int cancel(timer_core_id_t id)
+    {
+        ASSERT(is_initialized());
+
+        slot_t *timer = lookup(id);
+        if (NULL == timer)
+            return -1; /* not found */
+
+        array_remove(timer - _array);
+        return 0;
+    }
+
+    /** sets a time budget for each check() pass, in microseconds. While
+        non zero, handlers keep firing until the budget is spent instead
+        of up to max_simultaneous_timeouts per pass. At least one handler
+        runs per pass. */
+    void set_budget(unsigned long usecs)
+    { _budget = usecs; }
+
+    /** fills stats with the dispatch overrun counters */
+    void overrun(timer_overrun_t *stats)
+    { *stats = _overrun; }
+
+    /** fills stats with the figures of a timer (see TimerStats.h),
+        active or expired as long as its slot was not reused. Returns 0
+        if succesful, -1 if not found, if it never fired or if statistics
+        are disabled */
+    int stats(timer_core_id_t id, timer_stats_t *stats)
+    {
+        ASSERT(is_initialized());
+
+        slot_t *timer = lookup_slot(id);
+        if (NULL == timer)
+            return -1; /* not found */
+
+        return Stats::stats_get(timer - _array, stats);
+    }
+
+    /** fills trace with the i-th most recent fire, 0 being the latest.
+        Returns 0 if succesful, -1 otherwise */
+    int trace(int i, timer_trace_t *trace)
+    { return Stats::stats_trace(i, trace); }
+
+    /** prints statistics and trace to out, nothing if disabled */
+    void dump_stats(Print &out)
+    { Stats::stats_dump(out); }
+
+    /** fires expired timers, to be invoked by main loop() */
+    void check()
+    {
+        int count = 0;
+        unsigned char index;
+        ASSERT(is_initialized());
+
+        unsigned long start = micros();
+        ticks_t now = Clock::now();
+
+        /* advance the wheel up to now, moving due timers to the expired
+           list. Nothing to do if the wheel is empty, and a long gap is
+           cheaper to jump over than to tick through. */
+        if (0 == _wheel_count) {
+            _wheel_time = now + 1;
+        }
+        else {
+            ticks_t pending = now - _wheel_time + 1;
+            if ((ticks_t) N < pending)
+                wheel_jump(now);
+            else {
+                while (0 < pending --)
+                    wheel_tick();
+            }
+        }
+
+        while (TIMER_CORE_NIL != (index = _heads[EXPIRED])) {
+            slot_t *head = &_array[index];
+
+            if (out_of_budget(start, count)) {
+                defer();
+                break;
+            }
+
+            /* lateness is sampled right before the handler runs, so
+               timers fired later in the same pass account for it */
+            ticks_t fired = Clock::now();
+            ticks_t lateness = fired - head->deadline;
+            unsigned short jitter = timer_core_saturate(lateness);
+            if (head->jitter < jitter)
+                head->jitter = jitter;
+
+            if (head->deferred &&
+                _overrun.deferred_lateness < lateness)
+                _overrun.deferred_lateness = lateness;
+
+            head->deferred = 0;
+
+            unsigned short gen = head->gen;
+            timer_core_id_t id = timer_core_id(gen, index);
+            Stats::stats_begin();
+            int again = head->handler(id, fired, head->user_data);
+            Stats::stats_end(index, id, fired, lateness);
+
+            if (! again) {
+                /* the handler may have cancelled the timer already */
+                if (gen == head->gen && NO_BUCKET != head->bucket)
+                    array_remove(index);
+            }
+            else if (gen == head->gen && NO_BUCKET != head->bucket) {
+                /* reschedule */
+                unlink(index);
+                -- _wheel_count;
+
+                head->deadline = timer_core_next_deadline(head->deadline,
+                                                          head->dly, fired,
+                                                          _catchup);
+                wheel_add(index);
+            }
+
+            ++ count;
+        } /* while */
+    }
+
+private:
+    enum {
+        WHEEL_BITS   = 4,
+        WHEEL_SIZE   = 1 << WHEEL_BITS,
+        WHEEL_MASK   = WHEEL_SIZE - 1,
+        WHEEL_LEVELS = (8 * sizeof(ticks_t) + WHEEL_BITS - 1) / WHEEL_BITS,
+
+        /* bucket numbers: wheel buckets first, then the expired list */
+        EXPIRED      = WHEEL_LEVELS * WHEEL_SIZE,
+        NO_BUCKET    = 0x7FFF,
+    };
+
+    typedef struct {
+
+        /** absolute expiration time */
+        ticks_t deadline;
+
+        /** delay (ticks), also the rescheduling period */
+        ticks_t dly;
+
+        /** Scheduled time action */
+        handler_t *handler;
+
+        /** Reserved for the user */
+        void *user_data;
+
+        /** generation count, bumped on every allocation (see ids) */
+        unsigned short gen;
+
+        /** worst lateness seen so far (ticks, saturated) */
+        unsigned short jitter;
+
+        /** bucket this timer is linked in, NO_BUCKET if not active */
+        unsigned short bucket : 15;
+
+        /** left waiting by the last pass */
+        unsigned short deferred : 1;
+
+        /** bucket (or free list) links */
+        unsigned char next;
+        unsigned char prev;
+    } slot_t;
+
+    /* configurable parameters (see init) */
+    int _max_timeouts;
+    timer_catchup_t _catchup;
+    unsigned long _budget;
+
+    slot_t _array[N];
+    unsigned char _free_list;
+
+    /* list heads, one per bucket plus the expired list. Expired timers
+       wait there for their handler to run, oldest first. */
+    unsigned char _heads[EXPIRED + 1];
+    unsigned char _expired_tail;
+    int _wheel_count;
+
+    /* next tick to be processed by the wheel */
+    ticks_t _wheel_time;
+
+    timer_overrun_t _overrun;
+
+    int _initialized;
+
+    /* returns true if the current pass may not fire any more handlers */
+    int out_of_budget(unsigned long start, int count)
+    {
+        return (0 < _budget)
+            ? (0 < count && _budget <= micros() - start)
+            : (0 < _max_timeouts && _max_timeouts <= count);
+    }
+
+    /* flags the expired timers left waiting by this pass as deferred,
+       they are first in line for the next one */
+    void defer()
+    {
+        unsigned char index;
+
+        ++ _overrun.overruns;
+        for (index = _heads[EXPIRED]; TIMER_CORE_NIL != index;
+             index = _array[index].next) {
+            if (_array[index].deferred)
+                continue;
+
+            _array[index].deferred = 1;
+            ++ _overrun.deferred;
+        }
+    }
+
+    /* returns the slot last allocated to the timer with given id, active
+       or not, NULL if not found or reused since */
+    slot_t *lookup_slot(timer_core_id_t id)
+    {
+        int index = timer_core_index(id, N);
+        if (index < 0)
+            return NULL;
+
+        slot_t *timer = &_array[index];
+        return (timer->gen == timer_core_gen(id)) ? timer : NULL;
+    }
+
+    /* returns the active timer with given id, NULL if not found */
+    slot_t *lookup(timer_core_id_t id)
+    {
+        slot_t *timer = lookup_slot(id);
+        return (NULL != timer && NO_BUCKET != timer->bucket)
+            ? timer : NULL;
+    }
+
+    /* fetches a slot from the free list, NIL if none is left */
+    unsigned char array_insert()
+    {
+        unsigned char index = _free_list;
+        if (TIMER_CORE_NIL == index)
+            return TIMER_CORE_NIL;
+
+        /* fetch head from free list, the slot moves one generation on */
+        _free_list = _array[index].next;
+
+        ++ _array[index].gen;
+        _array[index].next = TIMER_CORE_NIL;
+
+        return index;
+    }
+
+    void array_remove(unsigned char index)
+    {
+        unlink(index);
+        -- _wheel_count;
+
+        /* put block back into free list */
+        _array[index].next = _free_list;
+        _free_list = index;
+    }
+
+    /* pushes timer in front of a bucket */
+    inline void link(unsigned bucket, unsigned char index)
+    {
+        slot_t *timer = &_array[index];
+
+        timer->bucket = bucket;
+        timer->prev = TIMER_CORE_NIL;
+        timer->next = _heads[bucket];
+        if (TIMER_CORE_NIL != timer->next)
+            _array[timer->next].prev = index;
+
+        _heads[bucket] = index;
+    }
+
+    /* appends timer to the expired list */
+    inline void link_expired(unsigned char index)
+    {
+        slot_t *timer = &_array[index];
+
+        timer->bucket = EXPIRED;
+        timer->next = TIMER_CORE_NIL;
+        timer->prev = _expired_tail;
+        if (TIMER_CORE_NIL != _expired_tail)
+            _array[_expired_tail].next = index;
+        else
+            _heads[EXPIRED] = index;
+
+        _expired_tail = index;
+    }
+
+    inline void unlink(unsigned char index)
+    {
+        slot_t *timer = &_array[index];
+
+        if (TIMER_CORE_NIL != timer->prev)
+            _array[timer->prev].next = timer->next;
+        else
+            _heads[timer->bucket] = timer->next;
+
+        if (TIMER_CORE_NIL != timer->next)
+            _array[timer->next].prev = timer->prev;
+        else if (EXPIRED == timer->bucket)
+            _expired_tail = timer->prev;
+
+        timer->bucket = NO_BUCKET;
+        timer->next = TIMER_CORE_NIL;
+        timer->prev = TIMER_CORE_NIL;
+    }
+
+    /* places a newly (re)scheduled timer on the wheel. Timers already
+       due, e.g. a late periodic timer rescheduled from its deadline, go
+       in the current bucket. */
+    void wheel_add(unsigned char index)
+    {
+        ticks_t deadline = _array[index].deadline;
+
+        ++ _wheel_count;
+        wheel_put(index, timer_core_before(deadline, _wheel_time)
+                  ? 0 : deadline - _wheel_time);
+    }
+
+    /* links timer in the bucket for delta ticks ahead of the wheel */
+    void wheel_put(unsigned char index, ticks_t delta)
+    {
+        ticks_t expires = _wheel_time + delta;
+        unsigned level = 0;
+
+        while (level < WHEEL_LEVELS - 1 &&
+               (delta >> (WHEEL_BITS * (level + 1))) != 0)
+            ++ level;
+
+        link(level * WHEEL_SIZE +
+             ((expires >> (WHEEL_BITS * level)) & WHEEL_MASK), index);
+    }
+
+    /* moves the wheel to now at once: timers due by then go to the
+       expired list, earliest first, the others back on the wheel */
+    void wheel_jump(ticks_t now)
+    {
+        unsigned char due = TIMER_CORE_NIL, later = TIMER_CORE_NIL;
+        unsigned char index, *link;
+        int i;
+
+        for (i = 0; i < N; ++ i) {
+            slot_t *timer = &_array[i];
+            if (EXPIRED <= timer->bucket)
+                continue; /* free, or expired already */
+
+            unlink(i);
+            if (timer_core_before(now, timer->deadline)) {
+                timer->next = later;
+                later = i;
+                continue;
+            }
+
+            /* keep the due ones sorted by deadline, there are few */
+            link = &due;
+            while (TIMER_CORE_NIL != *link &&
+                   ! timer_core_before(timer->deadline,
+                                       _array[*link].deadline))
+                link = &_array[*link].next;
+
+            timer->next = *link;
+            *link = i;
+        }
+
+        _wheel_time = now + 1;
+
+        while (TIMER_CORE_NIL != (index = due)) {
+            due = _array[index].next;
+            link_expired(index);
+        }
+
+        while (TIMER_CORE_NIL != (index = later)) {
+            later = _array[index].next;
+            wheel_put(index, _array[index].deadline - _wheel_time);
+        }
+    }
+
+    /* processes the current tick and moves the wheel one tick forward */
+    void wheel_tick()
+    {
+        ticks_t time = _wheel_time;
+        unsigned level = 0, bucket = time & WHEEL_MASK;
+        unsigned char index;
+
+        /* at the start of each round cascade one bucket from the level
+           above, going further up as long as that level wraps too */
+        while (0 == bucket && ++ level < WHEEL_LEVELS) {
+            bucket = (time >> (WHEEL_BITS * level)) & WHEEL_MASK;
+
+            while (TIMER_CORE_NIL !=
+                   (index = _heads[level * WHEEL_SIZE + bucket])) {
+                unlink(index);
+                wheel_put(index, _array[index].deadline - time);
+            }
+        }
+
+        /* everything in the current level 0 bucket is now due */
+        while (TIMER_CORE_NIL != (index = _heads[time & WHEEL_MASK])) {
+            unlink(index);
+            link_expired(index);
+        }
+
+        _wheel_time = time + 1;
+    }
+};
+
+#endif
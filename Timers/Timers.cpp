@@ -21,244 +21,106 @@
  * 02110-1301 USA
 **/
 #include <Timers.h>
-#include <Debug.h>
-
-#include <stdio.h>
-#include <string.h>
-#include <limits.h>
+#include <TimerCore.h>
+#include <TimerStats.h>
+
+#ifdef __AVR__
+#include <avr/interrupt.h>
+#include <avr/sleep.h>
+#endif
+
+#ifdef TIMERS_STATS
+typedef TimerStats<MAX_TIMERS> timers_stats_policy_t;
+#else
+typedef TimerNoStats timers_stats_policy_t;
+#endif
+
+#ifdef TIMERS_USE_WHEEL
+#include <TimerWheel.h>
+typedef TimerWheel<MillisClock, MAX_TIMERS,
+                   timers_stats_policy_t> timers_engine_t;
+#else
+#include <TimerQueue.h>
+typedef TimerQueue<MAX_TIMERS, MillisClock,
+                   timers_stats_policy_t> timers_engine_t;
+#endif
 
 /* -- static data ----------------------------------------------------------- */
+static timers_engine_t _tmrs;
 
-/* configurable parameters (see timers_init) */
-static int _tmrs_max_timeouts;
-
-static timer_t _tmrs_array[MAX_TIMERS];
-static timer_t *_tmrs_free_list;
-static timer_t *_tmrs_active_list;
-
-static int _tmrs_initialized = 0;
-static timer_id_t _tmrs_next_id = 0;
-
-/** -- static function prototypes ------------------------------------------- */
-static inline int timers_cmp( timer_t *a, timer_t *b );
-static inline void timers_set( timer_t *timer, ticks_t base, ticks_t dly);
-
-static int timers_array_insert( timer_t *timer );
-static int timers_array_remove( timer_t *timer );
+/* set by timers_wake(), cleared by timers_idle() */
+static volatile uint8_t _wake;
 
 /** -- public functions ----------------------------------------------------- */
 int timers_is_initialized()
-{ return _tmrs_initialized; }
-
-int timers_init(int max_simultaneous_timeouts)
-{
-    int i = MAX_TIMERS - 1;
-
-    _tmrs_free_list = NULL;
-    _tmrs_active_list = NULL;
+{ return _tmrs.is_initialized(); }
 
-    while (0 <= i) {
-        _tmrs_array[i].next = _tmrs_free_list;
-        _tmrs_free_list = &_tmrs_array[i];
-        -- i;
-    }
-
-    _tmrs_max_timeouts = max_simultaneous_timeouts;
-    _tmrs_initialized = 1;
-
-    return 0;
-}
+int timers_init(int max_simultaneous_timeouts, timer_catchup_t catchup)
+{ return _tmrs.init(max_simultaneous_timeouts, catchup); }
 
 /* returns timer id, -1 on failure. */
 timer_id_t timers_schedule( ticks_t dly, timer_handler_t handler,
                             void *user_data)
-{
-    timer_t timer;
-    ASSERT(timers_is_initialized());
+{ return _tmrs.schedule(dly, handler, user_data); }
 
-    /* populate data structure */
-    timer.id =  _tmrs_next_id ++;
-    timers_set( &timer, millis(), dly);
-    timer.handler = handler;
-    timer.user_data = user_data;
-
-    return (0 == timers_array_insert( &timer ))
-        ? timer.id : -1;
-}
-
-/* returns number of milliseconds before expiration, 0 if already
-   expired, UINT_MAX if not found */
 ticks_t timers_timeleft(timer_id_t id)
-{
-    timer_t *head = _tmrs_active_list;
-    ASSERT(timers_is_initialized());
+{ return _tmrs.timeleft(id); }
 
-    while (NULL != head) {
+ticks_t timers_next_deadline()
+{ return _tmrs.next_deadline(); }
 
-        if (head->id == id) {
-            ticks_t deadline = head->base + head->dly;
-            ticks_t now = millis();
-            return deadline > now
-                ? deadline - now
-                : 0;
-        }
-
-        head = head->next;
-    } /* while */
-
-    return UINT_MAX; /* not found */
-}
+ticks_t timers_jitter(timer_id_t id)
+{ return _tmrs.jitter(id); }
 
-int timers_cancel(timer_id_t id)
-{
-    timer_t *head = _tmrs_active_list;
-    ASSERT(timers_is_initialized());
+void timers_set_budget(unsigned long usecs)
+{ _tmrs.set_budget(usecs); }
 
-    while (NULL != head) {
+void timers_overrun(timer_overrun_t *stats)
+{ _tmrs.overrun(stats); }
 
-        if (head->id == id) {
-            int rc = timers_array_remove(head);
-            ASSERT (0 == rc);
+int timers_stats(timer_id_t id, timer_stats_t *stats)
+{ return _tmrs.stats(id, stats); }
 
-            return 0;
-        }
+int timers_trace(int i, timer_trace_t *trace)
+{ return _tmrs.trace(i, trace); }
 
-        head = head->next;
-    } /* while */
+void timers_dump_stats(Print &out)
+{ _tmrs.dump_stats(out); }
 
-    return -1; /* not found */
-}
+int timers_cancel(timer_id_t id)
+{ return _tmrs.cancel(id); }
 
 void timers_check()
-{
-    int rc, count = _tmrs_max_timeouts;
-    timer_t *next, *head;
-    ASSERT(timers_is_initialized());
+{ _tmrs.check(); }
 
-    static ticks_t last = NO_TICKS;
-    ticks_t now = millis();
+void timers_wake()
+{ _wake = 1; }
 
-    /* clock overflow detected, clear is_future flags */
-    if (now < last) {
-        head = _tmrs_active_list;
-        while (NULL != head) {
-            ASSERT(0 <= head->is_future);
-            -- head->is_future;
-            head = head->next;
-        }
-    }
-    last = now; /* save current clock ticks */
-
-    head = _tmrs_active_list;
-    while (NULL != head) {
-        ticks_t deadline = head->base + head->dly;
-        if ((1 == head->is_future) ||
-            (0 == head->is_future && (now < deadline)))
+void timers_idle()
+{
+#ifdef __AVR__
+    /* idle mode keeps timer0 running, its overflow interrupt drives
+       millis() and wakes us up */
+    set_sleep_mode(SLEEP_MODE_IDLE);
+
+    while (1) {
+        /* no interrupt may slip between the check and sleep_cpu(), sei()
+           takes effect only after the following instruction */
+        cli();
+
+        /* back to loop() when a timer is due, and when none is active:
+           nothing would ever be due then */
+        ticks_t left = _tmrs.next_deadline();
+        if (_wake || 0 == left || (ticks_t) ~(ticks_t) 0 == left) {
+            _wake = 0;
+            sei();
             break;
-
-        next = head->next;
-
-        if (! head->handler(head->id, now, head->user_data)) {
-            rc = timers_array_remove(head);
-            ASSERT(0 == rc);
-        }
-        else {
-            /* reschedule */
-            timers_set(head, deadline, head->dly);
         }
 
-        if (0 == -- count)
-            break;
-
-        head = next;
+        sleep_enable();
+        sei();
+        sleep_cpu();
+        sleep_disable();
     } /* while */
-}
-
-
-/* -- static functions ------------------------------------------------------ */
-static inline int timers_cmp( timer_t *a, timer_t *b )
-{
-    /* b is in the future, a is not => a comes first */
-    if (b->is_future > a->is_future)
-        return 1;
-
-    /* a is in the future, b is not => b comes first */
-    if (a->is_future > b->is_future)
-        return -1;
-
-    /* here a and b are either both present or both future, hence
-       ticks have the same interpretation */
-    ticks_t ta = a->base + a->dly;
-    ticks_t tb = b->base + b->dly;
-    return (ta <= tb) ? 1 : -1;
-}
-
-static int timers_array_insert( timer_t *timer )
-{
-    if (_tmrs_free_list == NULL)
-        return -1;
-
-    /* fetch head from free list */
-    timer_t *elem = _tmrs_free_list;
-    _tmrs_free_list = elem->next;
-
-    /* copy timer data  (avoid overlap) */
-    if (elem != timer) {
-        memcpy( elem, timer, sizeof(timer_t));
-    }
-
-    /* sorted insertion */
-    timer_t *previous = NULL, *eye = _tmrs_active_list;
-    while (NULL != eye && 0 < timers_cmp(eye, elem)) {
-        previous = eye;
-        eye = eye->next;
-    }
-
-    if (NULL == previous) {
-        _tmrs_active_list = elem;
-    }
-    else {
-        previous->next = elem;
-    }
-
-    elem->next = eye;
-    return 0;
-}
-
-static int timers_array_remove(timer_t *timer)
-{
-    timer_t *previous = NULL, *head = _tmrs_active_list;
-
-    if (NULL == head)
-        return -1;
-
-    while (NULL != head && head != timer) {
-        previous = head;
-        head = head->next;
-    }
-
-    if (head != timer)
-        return -1;
-
-    if (NULL == previous) {
-        _tmrs_active_list = head->next;
-    }
-    else {
-        previous->next = head->next;
-    }
-
-    /* put block back into free list */
-    timer->next = _tmrs_free_list;
-    _tmrs_free_list = timer;
-
-    return 0;
-}
-
-static inline void timers_set(timer_t *timer, ticks_t base, ticks_t dly)
-{
-    timer->base = base;
-    timer->dly  = dly;
-
-    /* is_future signals arithmetic overflow has occurred, timer is postponed */
-    timer->is_future = (base + dly < base) ? 1 : 0;
+#endif
 }
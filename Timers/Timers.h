@@ -23,55 +23,94 @@
 #ifndef TIMERS_H_DEFINED
 #define TIMERS_H_DEFINED
 
+#include <TimerCore.h>
+#include <TimerStats.h>
+
 const int MAX_TIMERS = 20;
 const int TIMERS_DEFAULT_MAX_SIMULTANEOUS_TIMEOUTS = 5;
 
+/* Active timers are kept in a binary heap by default. Uncomment the
+   following line to keep them in a hierarchical timing wheel instead
+   (see TimerWheel.h), which trades some RAM for O(1) schedule, cancel
+   and expiry. */
+/* #define TIMERS_USE_WHEEL */
+
+/* Uncomment the following line to record per timer dispatch statistics
+   and a trace of the latest fires (see TimerStats.h). When commented out
+   the statistics hooks compile to nothing. */
+/* #define TIMERS_STATS */
+
 /* -- custom typedefs ------------------------------------------------------- */
 
-typedef short timer_id_t;
+/* timer ids are generation-tagged slot indexes (see TimerCore.h) */
+typedef long timer_id_t;
 typedef unsigned long ticks_t;
 const ticks_t NO_TICKS = 0L;
 typedef int timer_handler_t(timer_id_t id, ticks_t now, void *ctx);
 
-typedef struct timer_TAG {
-
-    /** timer ID */
-    timer_id_t id;
-
-    /** delay (ms) */
-    ticks_t dly;
-
-    /** current time when timer was started */
-    ticks_t base;
-
-    /** flag used to prevent issues with clock overflow */
-    int is_future;
-
-    /** Scheduled time action */
-    timer_handler_t *handler;
-
-    /** Reserved for the user */
-    void *user_data;
-
-    struct timer_TAG *next;
-} timer_t;
-
 /* -- public interface ------------------------------------------------------ */
 
 /** returns true if lib is initialized, false otherwise */
 int timers_is_initialized();
 
-/** initializes the library. Must be invoked once, before using the library */
+/** initializes the library. Must be invoked once, before using the library.
+    catchup tells what to do with the periods a late periodic timer missed */
 int timers_init(int max_simultaneous_timeouts =
-                TIMERS_DEFAULT_MAX_SIMULTANEOUS_TIMEOUTS);
+                TIMERS_DEFAULT_MAX_SIMULTANEOUS_TIMEOUTS,
+                timer_catchup_t catchup = TIMER_CATCHUP_BURST);
 
-/** schedules a delayed action. returns timer id if succesful, -1 otherwise */
+/** schedules a delayed action. returns timer id if succesful, -1 otherwise.
+    dly must stay below half the ticks_t range (about 24 days) */
 timer_id_t timers_schedule(ticks_t dly, timer_handler_t handler,
                            void *user_data);
 
-/** returns number of milliseconds before expiration */
+/** returns number of milliseconds before expiration, 0 if already
+    expired, all ones if not found */
 ticks_t timers_timeleft(timer_id_t id);
 
+/** returns number of milliseconds before the earliest expiration, 0 if a
+    timer is already due, all ones if no timer is active */
+ticks_t timers_next_deadline();
+
+/** optional idle hook, to be invoked by main loop() right after
+    timers_check(). Puts the MCU in idle sleep until the next expiration,
+    waking up on every millis() tick interrupt to check again. Returns at
+    once if no timer is active. Interrupts whose work is done by loop(),
+    other than timers, must call timers_wake() to get it to run before
+    the next expiration. Does nothing on non-AVR builds. */
+void timers_idle();
+
+/** gets timers_idle() to return at once, e.g. from an ISR whose work is
+    completed by main loop(). Safe to invoke from interrupt context */
+void timers_wake();
+
+/** returns the worst lateness observed for a timer so far, saturated to
+    0xFFFF ticks; all ones if not found */
+ticks_t timers_jitter(timer_id_t id);
+
+/** sets a time budget for each timers_check() pass, in microseconds.
+    While non zero, handlers keep firing until the budget is spent instead
+    of up to max_simultaneous_timeouts per pass. 0 (the default) restores
+    the count based limit */
+void timers_set_budget(unsigned long usecs);
+
+/** fills stats with the dispatch overrun counters: expirations left
+    waiting by a pass are deferred to the next one and run first */
+void timers_overrun(timer_overrun_t *stats);
+
+/** fills stats with lateness and execution time figures of a timer,
+    expired one-shot timers included until their slot is reused. Returns
+    0 if succesful, -1 if not found, if it never fired or if
+    TIMERS_STATS is not defined */
+int timers_stats(timer_id_t id, timer_stats_t *stats);
+
+/** fills trace with the i-th most recent fire, 0 being the latest.
+    Returns 0 if succesful, -1 otherwise */
+int timers_trace(int i, timer_trace_t *trace);
+
+/** prints statistics of all timers and the trace to out, e.g. Serial */
+void timers_dump_stats(Print &out);
+
 /** cancels an existing timer. Returns 0 if succesful, -1 otherwise */
 int timers_cancel(timer_id_t id);
 